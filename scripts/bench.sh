@@ -0,0 +1,33 @@
+#!/usr/bin/env bash
+# Benchmark render_block on the host across all factory presets, and
+# check that preset switching does not allocate and every block is
+# exactly filled from the Blip_Buffers. Then time the GB oscillators,
+# Blip_Synth and Stereo_Buffer readout in isolation (tools/gb_osc_bench.cpp).
+#
+# Usage: ./scripts/bench.sh [chiptune_bench options]
+#   e.g. ./scripts/bench.sh -b 5000 -s poly
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+REPO_ROOT="$(dirname "$SCRIPT_DIR")"
+CXX="${CXX:-g++}"
+
+cd "$REPO_ROOT"
+
+"$SCRIPT_DIR/build_host.sh"
+
+echo "Compiling benchmark..."
+$CXX -g -O2 -std=c++14 tools/chiptune_bench.cpp -o build/host/chiptune_bench -rdynamic -ldl
+
+echo ""
+./build/host/chiptune_bench "$@" build/host/dsp.so
+
+echo ""
+echo "Compiling GB oscillator microbenchmarks..."
+GB_SRCS="src/libs/gb_snd_emu/Gb_Apu.cpp src/libs/gb_snd_emu/Gb_Oscs.cpp src/libs/gb_snd_emu/Blip_Buffer.cpp
+    src/libs/gb_snd_emu/Multi_Buffer.cpp"
+$CXX -g -O3 -std=c++14 -I src/libs/gb_snd_emu tools/gb_osc_bench.cpp $GB_SRCS \
+    -o build/host/gb_osc_bench
+
+echo ""
+./build/host/gb_osc_bench
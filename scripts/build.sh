@@ -122,6 +122,14 @@ cat src/module.json > dist/chiptune/module.json
 cat build/dsp.so > dist/chiptune/dsp.so
 chmod +x dist/chiptune/dsp.so
 
+# Include DMC samples in dist
+if [ -d "src/dmc" ]; then
+    mkdir -p dist/chiptune/dmc
+    for f in src/dmc/*.dmc; do
+        [ -f "$f" ] && cat "$f" > "dist/chiptune/dmc/$(basename "$f")"
+    done
+fi
+
 # Include chain patches in dist
 if [ -d "src/chain_patches" ]; then
     mkdir -p dist/chiptune/chain_patches
@@ -0,0 +1,74 @@
+#!/usr/bin/env bash
+# Build Chiptune dsp.so for the host machine (for benchmarks and checks)
+#
+# Output: build/host/dsp.so
+# Set CXX to pick a compiler (default: g++).
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+REPO_ROOT="$(dirname "$SCRIPT_DIR")"
+CXX="${CXX:-g++}"
+CXXFLAGS="-g -O3 -fPIC -std=c++14"
+OUT="build/host"
+
+cd "$REPO_ROOT"
+
+if [ ! -f src/libs/nes_snd_emu/nes_apu/Nes_Apu.h ]; then
+    echo "Error: src/libs/nes_snd_emu is missing. Run: git submodule update --init"
+    exit 1
+fi
+
+echo "=== Building Chiptune Module (host) ==="
+mkdir -p "$OUT"
+
+NES_SRCS="
+    src/libs/nes_snd_emu/nes_apu/Nes_Apu.cpp
+    src/libs/nes_snd_emu/nes_apu/Nes_Oscs.cpp
+    src/libs/nes_snd_emu/nes_apu/Blip_Buffer.cpp
+"
+
+for src in $NES_SRCS; do
+    obj="$OUT/$(basename "$src" .cpp).o"
+    $CXX $CXXFLAGS -I src/libs/nes_snd_emu -c "$src" -o "$obj"
+done
+
+GB_SRCS="
+    src/libs/gb_snd_emu/Gb_Apu.cpp
+    src/libs/gb_snd_emu/Gb_Oscs.cpp
+    src/libs/gb_snd_emu/Blip_Buffer.cpp
+    src/libs/gb_snd_emu/Multi_Buffer.cpp
+    src/libs/gb_snd_emu/gb_apu_wrapper.cpp
+"
+
+for src in $GB_SRCS; do
+    obj="$OUT/gb_$(basename "$src" .cpp).o"
+    $CXX $CXXFLAGS -fvisibility=hidden -I src/libs/gb_snd_emu -c "$src" -o "$obj"
+done
+
+# Same partial link as scripts/build.sh so the two Blip_Buffers stay apart
+ld -r \
+    "$OUT/gb_Gb_Apu.o" \
+    "$OUT/gb_Gb_Oscs.o" \
+    "$OUT/gb_Blip_Buffer.o" \
+    "$OUT/gb_Multi_Buffer.o" \
+    "$OUT/gb_gb_apu_wrapper.o" \
+    -o "$OUT/gb_apu_combined.o"
+objcopy --localize-hidden "$OUT/gb_apu_combined.o"
+
+$CXX $CXXFLAGS \
+    -I src/dsp \
+    -I src/libs/nes_snd_emu \
+    -I src/libs/gb_snd_emu \
+    -c src/dsp/chiptune_plugin.cpp \
+    -o "$OUT/chiptune_plugin.o"
+
+$CXX -shared \
+    "$OUT/chiptune_plugin.o" \
+    "$OUT/Nes_Apu.o" \
+    "$OUT/Nes_Oscs.o" \
+    "$OUT/Blip_Buffer.o" \
+    "$OUT/gb_apu_combined.o" \
+    -o "$OUT/dsp.so" \
+    -lm
+
+echo "Output: $OUT/dsp.so"
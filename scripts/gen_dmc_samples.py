@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Generate the NES DMC drum samples in src/dmc/
+
+Each sample is a raw 1-bit delta (.dmc) stream as the NES DMC channel
+plays it: one bit per output step, LSB first, +2 or -2 on the 7-bit DAC.
+Samples are encoded for playback rate 15 (33144 Hz), start and end at the
+DAC midpoint written before each note (64), and are padded with 0x55 to a
+length of 16*n + 1 bytes, the lengths register $4013 can express.
+
+Usage: ./scripts/gen_dmc_samples.py   (rewrites src/dmc/*.dmc)
+"""
+
+import math
+import os
+
+RATE = 1789773 / 54        # DMC rate index 15
+MAX_BYTES = 16 * 255 + 1   # longest sample $4013 can play
+MIDPOINT = 64
+
+OUT_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src", "dmc")
+
+
+class Noise:
+    """Deterministic white noise, so regenerated files are identical"""
+
+    def __init__(self, seed):
+        self.state = seed
+
+    def next(self):
+        self.state = (self.state * 1664525 + 1013904223) & 0xFFFFFFFF
+        return ((self.state >> 8) / float(1 << 24)) * 2.0 - 1.0
+
+
+def kick(t, noise):
+    # Pitch falls from 150 Hz to 45 Hz; phase is the integral of that
+    phase = 2.0 * math.pi * (45.0 * t + 105.0 * (1.0 - math.exp(-t * 30.0)) / 30.0)
+    return math.sin(phase) * math.exp(-t * 9.0)
+
+
+def snare(t, noise):
+    tone = math.sin(2.0 * math.pi * 190.0 * t) * math.exp(-t * 25.0)
+    return 0.45 * tone + 0.65 * noise.next() * math.exp(-t * 14.0)
+
+
+def tom(t, noise):
+    phase = 2.0 * math.pi * (110.0 * t + 110.0 * (1.0 - math.exp(-t * 12.0)) / 12.0)
+    return math.sin(phase) * math.exp(-t * 7.0)
+
+
+def hat(t, noise):
+    return noise.next() * math.exp(-t * 45.0)
+
+
+# (file name, generator, length in seconds, seed)
+SAMPLES = [
+    ("00_kick.dmc", kick, 0.30, 1),
+    ("01_snare.dmc", snare, 0.22, 2),
+    ("02_tom.dmc", tom, 0.40, 3),
+    ("03_hat.dmc", hat, 0.08, 4),
+]
+
+
+def encode(gen, seconds, seed):
+    noise = Noise(seed)
+    count = int(seconds * RATE)
+    level = MIDPOINT
+    bits = []
+    for i in range(count):
+        target = MIDPOINT + 60.0 * gen(i / RATE, noise)
+        up = target > level and level <= 125
+        if not up and level < 2:
+            up = True
+        bits.append(1 if up else 0)
+        level += 2 if up else -2
+    # Walk back to the midpoint, so a finished sample leaves the DAC where
+    # it started
+    while level != MIDPOINT:
+        up = level < MIDPOINT
+        bits.append(1 if up else 0)
+        level += 2 if up else -2
+    # Fill the last byte, and then whole bytes, with alternating steps
+    while len(bits) % 8:
+        bits.append(1 - bits[-1])
+
+    data = bytearray()
+    for i in range(0, len(bits), 8):
+        byte = 0
+        for b in range(8):
+            byte |= bits[i + b] << b
+        data.append(byte)
+    while len(data) % 16 != 1:
+        data.append(0x55)
+    return bytes(data[:MAX_BYTES])
+
+
+def main():
+    os.makedirs(OUT_DIR, exist_ok=True)
+    for name, gen, seconds, seed in SAMPLES:
+        data = encode(gen, seconds, seed)
+        with open(os.path.join(OUT_DIR, name), "wb") as f:
+            f.write(data)
+        print("%-14s %5d bytes" % (name, len(data)))
+
+
+if __name__ == "__main__":
+    main()
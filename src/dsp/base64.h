@@ -0,0 +1,92 @@
+/*
+ * base64.h - Allocation-free base64 (RFC 4648, padded) for binary params
+ *
+ * Usage:
+ *   int n = base64_encode(data, len, text, text_size);    (-1 if too small)
+ *   int m = base64_decode(text, data, data_size);         (-1 if invalid)
+ */
+
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <stdint.h>
+
+/* Text length for len bytes, excluding the terminating NUL */
+#define BASE64_ENCODED_LEN(len) ((((len) + 2) / 3) * 4)
+
+static const char g_base64_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*
+ * Encode len bytes into out, NUL-terminated.
+ * Returns: text length, or -1 if out_size is too small
+ */
+static inline int base64_encode(const uint8_t *data, int len, char *out, int out_size) {
+    int n = BASE64_ENCODED_LEN(len);
+    if (n >= out_size) return -1;
+    char *p = out;
+    int i = 0;
+    for (; i + 2 < len; i += 3) {
+        uint32_t v = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+        *p++ = g_base64_chars[(v >> 18) & 63];
+        *p++ = g_base64_chars[(v >> 12) & 63];
+        *p++ = g_base64_chars[(v >> 6) & 63];
+        *p++ = g_base64_chars[v & 63];
+    }
+    if (i < len) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)data[i + 1] << 8;
+        *p++ = g_base64_chars[(v >> 18) & 63];
+        *p++ = g_base64_chars[(v >> 12) & 63];
+        *p++ = (i + 1 < len) ? g_base64_chars[(v >> 6) & 63] : '=';
+        *p++ = '=';
+    }
+    *p = '\0';
+    return n;
+}
+
+static inline int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+/*
+ * Decode NUL-terminated padded base64 text into out.
+ * Returns: byte count, or -1 if the text is invalid or out_size is too small
+ */
+static inline int base64_decode(const char *text, uint8_t *out, int out_size) {
+    int n = 0;
+    while (*text) {
+        int v[4];
+        int pad = 0;
+        for (int k = 0; k < 4; k++) {
+            char c = text[k];
+            if (c == '\0') return -1;
+            if (c == '=' && k >= 2) {
+                pad++;
+                v[k] = 0;
+            } else {
+                if (pad) return -1;  /* data after padding */
+                v[k] = base64_value(c);
+                if (v[k] < 0) return -1;
+            }
+        }
+        text += 4;
+        if (pad && *text) return -1;  /* padding before the end */
+
+        uint32_t bits = ((uint32_t)v[0] << 18) | ((uint32_t)v[1] << 12) |
+                        ((uint32_t)v[2] << 6) | (uint32_t)v[3];
+        int bytes = 3 - pad;
+        if (n + bytes > out_size) return -1;
+        out[n++] = (uint8_t)(bits >> 16);
+        if (bytes > 1) out[n++] = (uint8_t)(bits >> 8);
+        if (bytes > 2) out[n++] = (uint8_t)bits;
+    }
+    return n;
+}
+
+#endif /* BASE64_H */
@@ -13,7 +13,9 @@
 #include <string.h>
 #include <math.h>
 #include <stdint.h>
+#include <time.h>
 #include <new>
+#include <atomic>
 
 /* Plugin API definitions */
 extern "C" {
@@ -66,27 +68,84 @@ extern "C" {
 /* Parameter helper */
 #include "param_helper.h"
 
+/* Saved state parsing */
+#include "json_scan.h"
+#include "base64.h"
+
+/* ADSR envelope */
+#include "envelope.h"
+
+/* MIDI event queue */
+#include "midi_queue.h"
+
+/* NES DMC sample bank */
+#include "dmc_bank.h"
+
 /* =====================================================================
  * Constants
  * ===================================================================== */
 
 #define NES_CPU_CLOCK   1789773
 #define GB_CPU_CLOCK    4194304
-#define SAMPLE_RATE     44100
-#define FRAMES_PER_BLOCK 128
+#define DEFAULT_SAMPLE_RATE      44100   /* if the host doesn't say */
+#define DEFAULT_FRAMES_PER_BLOCK 128
+#define MAX_CHUNK_FRAMES         256     /* longest span emulated in one go */
 #define MAX_VOICES      5
 #define NUM_PRESETS      32
 #define NUM_WAVETABLES   8
 
-/* NES cycles per audio block: 128 * 1789773 / 44100 */
-#define NES_CYCLES_PER_BLOCK ((FRAMES_PER_BLOCK * NES_CPU_CLOCK + SAMPLE_RATE / 2) / SAMPLE_RATE)
-/* GB cycles per audio block: 128 * 4194304 / 44100 */
-#define GB_CYCLES_PER_BLOCK  ((FRAMES_PER_BLOCK * GB_CPU_CLOCK + SAMPLE_RATE / 2) / SAMPLE_RATE)
+/* Idle fast path: once no voice is active and the Blip_Buffer output has
+ * stayed within +/-QUIESCENT_LEVEL (raw samples, before output gain) for
+ * QUIESCENT_BLOCKS blocks, render_block skips emulation entirely. */
+#define QUIESCENT_LEVEL  1
+#define QUIESCENT_BLOCKS 2
+
+/* Gain from raw APU samples to the output, saturating. Both chips peak
+ * around 5000, so 6x gives ~30000 with headroom within int16. */
+#define OUTPUT_GAIN 6
+
+/* Blip_Buffer length in render chunks. Each chunk is read out right after it
+ * is rendered, so one chunk plus headroom is all that is ever buffered. */
+#define BLIP_BUFFER_BLOCKS 2
+
+/* Register shadow ranges: $4000-$4017 and $FF10-$FF3F */
+#define NES_SHADOW_BASE 0x4000
+#define NES_SHADOW_REGS 0x18
+#define GB_SHADOW_BASE  0xFF10
+#define GB_SHADOW_REGS  0x30
 
 /* Chip types */
 #define CHIP_NES 0
 #define CHIP_GB  1
 
+/* Vibrato LFO shapes */
+#define LFO_SINE     0
+#define LFO_TRIANGLE 1
+#define LFO_SQUARE   2
+#define LFO_SAMPLE_HOLD 3
+#define NUM_LFO_SHAPES  4
+
+/* Modulation control rates: how often envelope, pitch envelope and vibrato
+ * are written to the APU (see render_chunk) */
+#define CTRL_BLOCK  0  /* once per render chunk */
+#define CTRL_64     1  /* every 64 samples */
+#define CTRL_32     2
+#define CTRL_16     3
+#define CTRL_60HZ   4  /* game sound driver tick rates */
+#define CTRL_240HZ  5
+#define NUM_CTRL_RATES 6
+
+/* Voice update kinds (see nes_update_voices) */
+#define UPDATE_BLOCK 0  /* advance through the coming segment, then write */
+#define UPDATE_TICK  1  /* advance through the samples since the last tick */
+#define UPDATE_NEW   2  /* only trigger voices started since the last tick */
+
+/* Operations requested by set_param, run by the audio thread at the start
+ * of the next block (see params_fetch) */
+#define OP_KILL_VOICES    0x01
+#define OP_RESET_APUS     0x02
+#define OP_LOAD_WAVETABLE 0x04  /* GB only */
+
 /* Allocation modes */
 #define ALLOC_AUTO   0
 #define ALLOC_LEAD   1
@@ -98,14 +157,13 @@ extern "C" {
 #define CHAN_TRIANGLE 2
 #define CHAN_WAVE     2  /* GB wave = channel index 2, same slot as triangle */
 #define CHAN_NOISE    3
-#define CHAN_DMC      4  /* NES only, not used for voices */
+#define CHAN_DMC      4  /* NES only, when the DMC sample bank is not empty */
 
-/* Envelope stages (ADSR) */
-#define ENV_IDLE    0
-#define ENV_ATTACK  1
-#define ENV_DECAY   2
-#define ENV_SUSTAIN 3
-#define ENV_RELEASE 4
+/* DMC voices: key DMC_BASE_NOTE plays sample 0, the next key sample 1, and
+ * so on, at the highest DMC rate, starting from the DAC midpoint */
+#define DMC_BASE_NOTE 36
+#define DMC_RATE      0x0F
+#define DMC_MIDPOINT  64
 
 /* =====================================================================
  * Host API reference
@@ -143,29 +201,199 @@ enum ChiptuneParam {
     P_ALLOC_MODE,
     P_PITCH_ENV_DEPTH,
     P_PITCH_ENV_SPEED,
+    P_VIBRATO_SHAPE,
+    P_CONTROL_RATE,
     P_COUNT
 };
 
+/* Enum option names, from value 0 up */
+static const char *const g_chip_names[] = {"NES", "GB"};
+static const char *const g_alloc_mode_names[] = {"Auto", "Lead", "Locked"};
+static const char *const g_noise_mode_names[] = {"Long", "Short"};
+static const char *const g_lfo_shape_names[NUM_LFO_SHAPES] = {"Sine", "Triangle", "Square", "S&H"};
+static const char *const g_ctrl_rate_names[NUM_CTRL_RATES] = {
+    "Block", "64", "32", "16", "60 Hz", "240 Hz"
+};
+
+/* Listed in ChiptuneParam order: a param's position is its P_* id */
 static const param_def_t g_param_defs[] = {
-    {"duty",             "Duty Cycle",    PARAM_TYPE_INT,   P_DUTY,             0.0f, 3.0f},
-    {"env_attack",       "Attack",        PARAM_TYPE_INT,   P_ENV_ATTACK,       0.0f, 15.0f},
-    {"env_decay",        "Decay",         PARAM_TYPE_INT,   P_ENV_DECAY,        0.0f, 15.0f},
-    {"env_sustain",      "Sustain",       PARAM_TYPE_INT,   P_ENV_SUSTAIN,      0.0f, 15.0f},
-    {"env_release",      "Release",       PARAM_TYPE_INT,   P_ENV_RELEASE,      0.0f, 15.0f},
-    {"sweep",            "Sweep",         PARAM_TYPE_INT,   P_SWEEP,            0.0f, 7.0f},
-    {"vibrato_depth",    "Vibrato Depth", PARAM_TYPE_INT,   P_VIBRATO_DEPTH,    0.0f, 12.0f},
-    {"vibrato_rate",     "Vibrato Rate",  PARAM_TYPE_INT,   P_VIBRATO_RATE,     0.0f, 10.0f},
-    {"noise_mode",       "Noise Mode",    PARAM_TYPE_INT,   P_NOISE_MODE,       0.0f, 1.0f},
-    {"wavetable",        "Wavetable (GB)",PARAM_TYPE_INT,   P_WAVETABLE,        0.0f, 7.0f},
-    {"channel_mask",     "Channel Mask",  PARAM_TYPE_INT,   P_CHANNEL_MASK,     0.0f, 15.0f},
-    {"detune",           "Detune",        PARAM_TYPE_INT,   P_DETUNE,           0.0f, 50.0f},
-    {"volume",           "Volume",        PARAM_TYPE_INT,   P_VOLUME,           0.0f, 15.0f},
-    {"octave_transpose", "Octave",        PARAM_TYPE_INT,   P_OCTAVE_TRANSPOSE, -3.0f, 3.0f},
-    {"alloc_mode",       "Voice Mode",    PARAM_TYPE_INT,   P_ALLOC_MODE,       0.0f, 2.0f},
-    {"pitch_env_depth",  "PEnv Depth",    PARAM_TYPE_INT,   P_PITCH_ENV_DEPTH,  0.0f, 24.0f},
-    {"pitch_env_speed",  "PEnv Speed",    PARAM_TYPE_INT,   P_PITCH_ENV_SPEED,  0.0f, 15.0f},
+    {"duty",             "Duty Cycle",    PARAM_TYPE_INT,   P_DUTY,             0.0f, 3.0f,  NULL},
+    {"env_attack",       "Attack",        PARAM_TYPE_INT,   P_ENV_ATTACK,       0.0f, 15.0f, NULL},
+    {"env_decay",        "Decay",         PARAM_TYPE_INT,   P_ENV_DECAY,        0.0f, 15.0f, NULL},
+    {"env_sustain",      "Sustain",       PARAM_TYPE_INT,   P_ENV_SUSTAIN,      0.0f, 15.0f, NULL},
+    {"env_release",      "Release",       PARAM_TYPE_INT,   P_ENV_RELEASE,      0.0f, 15.0f, NULL},
+    {"sweep",            "Sweep",         PARAM_TYPE_INT,   P_SWEEP,            0.0f, 7.0f,  NULL},
+    {"vibrato_depth",    "Vibrato Depth", PARAM_TYPE_INT,   P_VIBRATO_DEPTH,    0.0f, 12.0f, NULL},
+    {"vibrato_rate",     "Vibrato Rate",  PARAM_TYPE_INT,   P_VIBRATO_RATE,     0.0f, 10.0f, NULL},
+    {"noise_mode",       "Noise Mode",    PARAM_TYPE_INT,   P_NOISE_MODE,       0.0f, 1.0f,  g_noise_mode_names},
+    {"wavetable",        "Wavetable (GB)",PARAM_TYPE_INT,   P_WAVETABLE,        0.0f, 7.0f,  NULL},
+    {"channel_mask",     "Channel Mask",  PARAM_TYPE_INT,   P_CHANNEL_MASK,     0.0f, 31.0f, NULL},
+    {"detune",           "Detune",        PARAM_TYPE_INT,   P_DETUNE,           0.0f, 50.0f, NULL},
+    {"volume",           "Volume",        PARAM_TYPE_INT,   P_VOLUME,           0.0f, 15.0f, NULL},
+    {"octave_transpose", "Octave",        PARAM_TYPE_INT,   P_OCTAVE_TRANSPOSE, -3.0f, 3.0f,  NULL},
+    {"alloc_mode",       "Voice Mode",    PARAM_TYPE_INT,   P_ALLOC_MODE,       0.0f, 2.0f,  g_alloc_mode_names},
+    {"pitch_env_depth",  "PEnv Depth",    PARAM_TYPE_INT,   P_PITCH_ENV_DEPTH,  0.0f, 24.0f, NULL},
+    {"pitch_env_speed",  "PEnv Speed",    PARAM_TYPE_INT,   P_PITCH_ENV_SPEED,  0.0f, 15.0f, NULL},
+    {"vibrato_shape",    "Vibrato Shape", PARAM_TYPE_INT,   P_VIBRATO_SHAPE,    0.0f, 3.0f,  g_lfo_shape_names},
+    {"control_rate",     "Mod Rate",      PARAM_TYPE_INT,   P_CONTROL_RATE,     0.0f, 5.0f,  g_ctrl_rate_names},
+};
+
+/* Other keys handled by set_param/get_param, numbered after the params */
+enum ChiptuneKey {
+    K_NAME = P_COUNT,
+    K_STATE,
+    K_STATE_BIN,
+    K_PRESET,
+    K_PRESET_COUNT,
+    K_PRESET_NAME,
+    K_CHIP,
+    K_ALL_NOTES_OFF,
+    K_UI_HIERARCHY,
+    K_CHAIN_PARAMS,
+    K_UNDERRUN_BLOCKS,
+    K_OVERRUN_BLOCKS,
+    K_MIDI_DROPPED,
+    K_REG_WRITES_ISSUED,
+    K_REG_WRITES_SUPPRESSED
+};
+
+static const struct {
+    const char *key;
+    int id;
+} g_special_keys[] = {
+    {"name",                  K_NAME},
+    {"state",                 K_STATE},
+    {"state_bin",             K_STATE_BIN},
+    {"preset",                K_PRESET},
+    {"preset_count",          K_PRESET_COUNT},
+    {"preset_name",           K_PRESET_NAME},
+    {"chip",                  K_CHIP},
+    {"all_notes_off",         K_ALL_NOTES_OFF},
+    {"ui_hierarchy",          K_UI_HIERARCHY},
+    {"chain_params",          K_CHAIN_PARAMS},
+    {"underrun_blocks",       K_UNDERRUN_BLOCKS},
+    {"overrun_blocks",        K_OVERRUN_BLOCKS},
+    {"midi_dropped",          K_MIDI_DROPPED},
+    {"reg_writes_issued",     K_REG_WRITES_ISSUED},
+    {"reg_writes_suppressed", K_REG_WRITES_SUPPRESSED},
+};
+
+/* Key string -> P_* or K_* id, so set_param/get_param dispatch with one
+ * hash lookup instead of a strcmp chain */
+static param_index_t g_key_index;
+static int g_key_index_ready = 0;
+
+static void key_index_init(void) {
+    if (g_key_index_ready) return;
+    param_index_init(&g_key_index);
+    for (int i = 0; i < (int)PARAM_DEF_COUNT(g_param_defs); i++) {
+        if (g_param_defs[i].index != i) plugin_log("Parameter table out of order");
+    }
+    if (param_index_defs(&g_key_index, g_param_defs, PARAM_DEF_COUNT(g_param_defs)) != 0) {
+        plugin_log("Duplicate parameter key");
+    }
+    for (int i = 0; i < (int)(sizeof(g_special_keys) / sizeof(g_special_keys[0])); i++) {
+        if (param_index_add(&g_key_index, g_special_keys[i].key, g_special_keys[i].id) != 0) {
+            plugin_log("Duplicate parameter key");
+        }
+    }
+    g_key_index_ready = 1;
+}
+
+/* =====================================================================
+ * Host metadata JSON
+ *
+ * chain_params and ui_hierarchy only depend on the tables, so they are
+ * generated once at init and copied out on each get_param.
+ * ===================================================================== */
+
+/* Chip lives in inst->ui.chip rather than the params array, but is
+ * described to the host like any other enum */
+static const param_def_t g_chip_def =
+    {"chip", "Chip", PARAM_TYPE_INT, -1, 0.0f, 1.0f, g_chip_names};
+
+/* Knob assignments and the parameter page, by key */
+static const char *const g_ui_knobs[] = {
+    "env_attack", "env_decay", "env_sustain", "env_release",
+    "duty", "vibrato_depth", "vibrato_rate", "volume",
+};
+static const char *const g_ui_params[] = {
+    "chip", "duty", "env_attack", "env_decay", "env_sustain", "env_release",
+    "sweep", "vibrato_depth", "vibrato_rate", "vibrato_shape",
+    "pitch_env_depth", "pitch_env_speed", "control_rate", "alloc_mode",
+    "noise_mode", "wavetable", "volume", "octave_transpose",
 };
 
+#define META_JSON_MAX 4096
+
+static char g_chain_params_json[META_JSON_MAX];
+static int g_chain_params_len = -1;
+static char g_ui_hierarchy_json[META_JSON_MAX];
+static int g_ui_hierarchy_len = -1;
+
+static const char *param_label(const char *key) {
+    int id = param_index_find(&g_key_index, key);
+    if (id >= 0 && id < P_COUNT) return g_param_defs[id].name;
+    if (id == K_CHIP) return g_chip_def.name;
+    return key;
+}
+
+/* Append a quoted key list to buf; returns the new offset */
+static int json_key_list(char *buf, int offset, int buf_len,
+                         const char *const *keys, int count) {
+    for (int i = 0; i < count && offset < buf_len; i++) {
+        offset += snprintf(buf + offset, buf_len - offset, "%s\"%s\"",
+                           i > 0 ? "," : "", keys[i]);
+    }
+    return offset;
+}
+
+static int ui_hierarchy_json(char *buf, int buf_len) {
+    int knob_count = (int)(sizeof(g_ui_knobs) / sizeof(g_ui_knobs[0]));
+    int param_count = (int)(sizeof(g_ui_params) / sizeof(g_ui_params[0]));
+    int offset = snprintf(buf, buf_len,
+        "{\"modes\":null,\"levels\":{"
+            "\"root\":{"
+                "\"list_param\":\"preset\","
+                "\"count_param\":\"preset_count\","
+                "\"name_param\":\"preset_name\","
+                "\"children\":\"main\","
+                "\"knobs\":[");
+    offset = json_key_list(buf, offset, buf_len, g_ui_knobs, knob_count);
+    if (offset < buf_len) {
+        offset += snprintf(buf + offset, buf_len - offset,
+                "],"
+                "\"params\":[]"
+            "},"
+            "\"main\":{"
+                "\"label\":\"Parameters\","
+                "\"children\":null,"
+                "\"knobs\":[");
+    }
+    offset = json_key_list(buf, offset, buf_len, g_ui_knobs, knob_count);
+    if (offset < buf_len) offset += snprintf(buf + offset, buf_len - offset, "],\"params\":[");
+    for (int i = 0; i < param_count && offset < buf_len; i++) {
+        offset += snprintf(buf + offset, buf_len - offset, "%s{\"key\":\"%s\",\"label\":\"%s\"}",
+                           i > 0 ? "," : "", g_ui_params[i], param_label(g_ui_params[i]));
+    }
+    if (offset < buf_len) offset += snprintf(buf + offset, buf_len - offset, "]}}}");
+    if (offset >= buf_len) return -1;
+    return offset;
+}
+
+static void meta_json_init(void) {
+    /* Chip first, then the params in table order */
+    param_def_t defs[P_COUNT + 1];
+    defs[0] = g_chip_def;
+    memcpy(&defs[1], g_param_defs, sizeof(g_param_defs));
+    g_chain_params_len = param_helper_chain_params_json(defs, P_COUNT + 1,
+                                                        g_chain_params_json, META_JSON_MAX);
+    g_ui_hierarchy_len = ui_hierarchy_json(g_ui_hierarchy_json, META_JSON_MAX);
+    if (g_chain_params_len < 0 || g_ui_hierarchy_len < 0) {
+        plugin_log("Parameter metadata too large");
+    }
+}
+
 /* =====================================================================
  * GB Wavetables
  * ===================================================================== */
@@ -299,34 +527,51 @@ static const chiptune_preset_t g_factory_presets[NUM_PRESETS] = {
 };
 
 /* =====================================================================
- * Voice and envelope structures
+ * Voice structure
  * ===================================================================== */
 
-struct voice_envelope_t {
-    float level;
-    int stage;          /* ENV_IDLE, ENV_ATTACK, ENV_DECAY, ENV_SUSTAIN, ENV_RELEASE */
-    float attack_inc;   /* per-sample increment during attack */
-    float decay_dec;    /* per-sample decrement during decay */
-    float sustain_level; /* sustain level 0.0-1.0 */
-    float release_dec;  /* per-sample decrement during release */
-};
-
 struct voice_t {
     int active;
     int note;          /* MIDI note (after octave transpose) */
     int velocity;
-    int channel_idx;   /* Which APU channel this voice is on (0-3) */
-    int channel_type;  /* CHAN_PULSE1, CHAN_PULSE2, CHAN_TRIANGLE/WAVE, CHAN_NOISE */
+    int channel_idx;   /* Which APU channel this voice is on (0-4) */
+    int channel_type;  /* CHAN_PULSE1, CHAN_PULSE2, CHAN_TRIANGLE/WAVE, CHAN_NOISE, CHAN_DMC */
     int age;
     int triggered;     /* 1 = already triggered this note, skip re-trigger */
     voice_envelope_t env;
     float pitch_env;   /* Current pitch offset in semitones (decays toward 0) */
+    int ctrl_ahead;    /* samples already advanced past the last control tick */
 };
 
 /* =====================================================================
  * Instance structure
  * ===================================================================== */
 
+/* Everything set_param can change that the audio thread reads */
+typedef struct {
+    float params[P_COUNT];
+    uint8_t chip;
+} param_snapshot_t;
+
+#define SNAPSHOT_NEW 4  /* flag in snap_latest: not yet picked up */
+
+#define STATE_JSON_MAX 1024
+#define STATE_MAX_MEMBERS 64  /* members accepted in a saved state object */
+
+/* Binary state ("state_bin"), base64 in the param string. Little-endian:
+ *   0  magic "CHPT"
+ *   4  version (STATE_BIN_VERSION)
+ *   5  preset index
+ *   6  chip
+ *   7  param count N
+ *   8  N x float32 params in ChiptuneParam order
+ * New params are only ever appended, so an older blob restores its params
+ * and takes the rest from its preset; extra params from a newer one are
+ * ignored. The version changes only if this layout does. */
+#define STATE_BIN_VERSION 1
+#define STATE_BIN_HEADER  8
+#define STATE_BIN_MAX     (STATE_BIN_HEADER + 4 * 255)
+
 typedef struct {
     char module_dir[256];
 
@@ -337,55 +582,280 @@ typedef struct {
     Nes_Apu nes_apu;
     Blip_Buffer nes_blip;
 
+    /* DMC samples, shared with other instances from the same module_dir.
+     * The DMC reader serves dmc_sample, the one last started. */
+    dmc_bank_t *dmc_bank;
+    const dmc_sample_t *dmc_sample;
+    int dmc_playing;  /* started and not stopped since (it may have ended) */
+
     /* GB APU (blargg) */
     gb_apu_wrapper_t *gb_apu;
 
+    /* Register shadows: last value written to each register, -1 = unknown.
+     * Unchanged writes are skipped (see nes_write / gb_write). */
+    int16_t nes_shadow[NES_SHADOW_REGS];
+    int16_t gb_shadow[GB_SHADOW_REGS];
+    uint8_t gb_silenced;                /* bit per GB channel already silenced */
+    unsigned long reg_writes_issued;
+    unsigned long reg_writes_suppressed;
+
     /* Voice allocator */
     voice_t voices[MAX_VOICES];
     int voice_age_counter;
 
     /* LFO */
-    float lfo_phase;  /* 0.0 to 1.0 */
+    uint32_t lfo_phase;   /* Vibrato LFO phase, full cycle = 2^32 */
+    int32_t lfo_hold;     /* Sample & hold value (Q15) */
+    uint32_t lfo_rand;    /* Sample & hold noise state */
 
     /* Pitch bend */
     float pitch_bend_semitones;
 
-    /* Parameters */
+    /* Mod wheel vibrato depth, replacing P_VIBRATO_DEPTH until the
+     * parameter itself next changes; < 0 if the wheel hasn't moved since.
+     * Audio thread only, like the params it overrides. */
+    float mod_vibrato_depth;
+
+    /* MIDI events from on_midi, applied by render_block at their sample
+     * offset. Offsets are measured from the start of the previous render
+     * call, which costs one block of latency but keeps event spacing. */
+    midi_queue_t midi_queue;
+    uint32_t midi_block_end;               /* queue snapshot for this block */
+    std::atomic<int64_t> render_start_ns;  /* 0 until the first render */
+    unsigned midi_dropped;                 /* events lost to a full queue */
+
+    /* Modulation control ticks (sub-block control rates only) */
+    int ctrl_rate;        /* control rate the tick state below belongs to */
+    int ctrl_countdown;   /* samples until the next tick */
+    uint32_t ctrl_frac;   /* Q16 fraction of the tick period carried over */
+    int ctrl_elapsed;     /* samples since the last tick */
+
+    /* Idle fast path */
+    int quiescent;       /* 1 = APUs silent and output settled, skip emulation */
+    int settled_blocks;  /* consecutive silent blocks with no active voices */
+
+    /* Blip_Buffer readout monitoring (see render_chunk) */
+    unsigned underrun_blocks;  /* fewer samples than frames: tail left silent */
+    unsigned overrun_blocks;   /* more samples than frames: surplus dropped */
+
+    /* Parameters, as used by the audio thread */
     float params[P_COUNT];
+
+    /* Control thread's copy: set_param edits it and get_param reports it.
+     * Each change is published through a triple buffer (snapshots[] and
+     * the three slot indices) and picked up at the next block start. */
+    param_snapshot_t ui;
     int current_preset;
     char preset_name[64];
+    char state_json[STATE_JSON_MAX];  /* last "state" reply, rebuilt when dirty */
+    int state_len;
+    int state_dirty;
+    param_snapshot_t snapshots[3];
+    int snap_back;                    /* slot the control thread fills */
+    int snap_front;                   /* slot the audio thread last took */
+    std::atomic<int> snap_latest;     /* slot last published | SNAPSHOT_NEW */
+    std::atomic<uint32_t> pending_ops;  /* OP_* bits */
+
+    /* Host audio format. render_block emulates at most chunk_frames at a
+     * time (the host block size, capped at MAX_CHUNK_FRAMES). */
+    int sample_rate;
+    int chunk_frames;
 
     /* Temp buffers */
-    int16_t nes_mono_buf[FRAMES_PER_BLOCK + 64];
-    int16_t gb_stereo_buf[(FRAMES_PER_BLOCK + 64) * 2];
+    int16_t nes_mono_buf[MAX_CHUNK_FRAMES];
 } chiptune_instance_t;
 
 /* =====================================================================
- * Utility functions
+ * Pitch tables
+ *
+ * Pitch is an integer in 1/64 semitone steps above MIDI note 0, with
+ * PITCH_FRAC_BITS of interpolation fraction below that. Every channel's
+ * period register is some clock / (divider * freq), i.e. a fixed period
+ * at note 0 scaled by 2^(-pitch/768), so one octave table of that scale
+ * (filled at init) plus an octave shift serves all channel types.
  * ===================================================================== */
 
-static float midi_to_freq(int note) {
-    return 440.0f * powf(2.0f, (note - 69) / 12.0f);
+#define PITCH_STEPS_PER_SEMITONE 64
+#define PITCH_STEPS_PER_OCTAVE   (12 * PITCH_STEPS_PER_SEMITONE)
+#define PITCH_FRAC_BITS          8
+#define PITCH_SEMITONE           (PITCH_STEPS_PER_SEMITONE << PITCH_FRAC_BITS)
+
+/* Channel period bases (see g_period_base_q16) */
+#define PERIOD_NES_PULSE    0   /* 1789773 / (16 * freq) */
+#define PERIOD_NES_TRIANGLE 1   /* 1789773 / (32 * freq) */
+#define PERIOD_GB_SQUARE    2   /* 131072 / freq */
+#define PERIOD_GB_WAVE      3   /* 65536 / freq */
+#define PERIOD_COUNT        4
+
+/* 2^(-i/768) in Q31, i = 0..768 */
+static uint32_t g_pitch_scale[PITCH_STEPS_PER_OCTAVE + 1];
+/* Period in clocks at MIDI note 0, Q16 */
+static uint32_t g_period_base_q16[PERIOD_COUNT];
+static int g_pitch_tables_ready = 0;
+
+static void pitch_tables_init(void) {
+    if (g_pitch_tables_ready) return;
+    for (int i = 0; i <= PITCH_STEPS_PER_OCTAVE; i++) {
+        g_pitch_scale[i] = (uint32_t)(pow(2.0, -(double)i / PITCH_STEPS_PER_OCTAVE) * 2147483648.0 + 0.5);
+    }
+    const double note0_freq = 440.0 * pow(2.0, -69.0 / 12.0);
+    const double clocks[PERIOD_COUNT] = {
+        NES_CPU_CLOCK / 16.0, NES_CPU_CLOCK / 32.0, 131072.0, 65536.0
+    };
+    for (int i = 0; i < PERIOD_COUNT; i++) {
+        g_period_base_q16[i] = (uint32_t)(clocks[i] / note0_freq * 65536.0 + 0.5);
+    }
+    g_pitch_tables_ready = 1;
+}
+
+/* Pitch units from a (fractional) semitone offset */
+static int32_t pitch_from_semitones(float semitones) {
+    float units = semitones * (float)PITCH_SEMITONE;
+    return (int32_t)(units < 0.0f ? units - 0.5f : units + 0.5f);
 }
 
-/* NES pulse period from frequency: period = 1789773 / (16 * freq) - 1 */
-static int nes_pulse_period(float freq) {
-    if (freq < 1.0f) freq = 1.0f;
-    int period = (int)(NES_CPU_CLOCK / (16.0f * freq) - 1.0f + 0.5f);
+static int32_t pitch_from_note(int note) {
+    return note * PITCH_SEMITONE;
+}
+
+/* Channel period in clocks (Q16) for a pitch */
+static int64_t pitch_period_q16(int which, int32_t pitch) {
+    if (pitch < 0) pitch = 0;
+    int step = pitch >> PITCH_FRAC_BITS;
+    int frac = pitch & ((1 << PITCH_FRAC_BITS) - 1);
+    int octave = step / PITCH_STEPS_PER_OCTAVE;
+    int idx = step % PITCH_STEPS_PER_OCTAVE;
+    if (octave > 31) return 0;
+
+    /* Linear interpolation between adjacent 1/64-semitone entries */
+    int64_t scale = g_pitch_scale[idx] -
+        (((int64_t)(g_pitch_scale[idx] - g_pitch_scale[idx + 1]) * frac) >> PITCH_FRAC_BITS);
+    return ((int64_t)g_period_base_q16[which] * scale) >> (31 + octave);
+}
+
+/* Round a Q16 value to the nearest integer */
+#define Q16_ROUND(x) ((int)(((x) + 32768) >> 16))
+
+/* NES pulse period: period = 1789773 / (16 * freq) - 1 */
+static int nes_pulse_period(int32_t pitch) {
+    int period = Q16_ROUND(pitch_period_q16(PERIOD_NES_PULSE, pitch) - 65536);
     if (period < 0) period = 0;
     if (period > 0x7FF) period = 0x7FF;
     return period;
 }
 
-/* NES triangle period from frequency: period = 1789773 / (32 * freq) - 1 */
-static int nes_triangle_period(float freq) {
-    if (freq < 1.0f) freq = 1.0f;
-    int period = (int)(NES_CPU_CLOCK / (32.0f * freq) - 1.0f + 0.5f);
+/* NES triangle period: period = 1789773 / (32 * freq) - 1 */
+static int nes_triangle_period(int32_t pitch) {
+    int period = Q16_ROUND(pitch_period_q16(PERIOD_NES_TRIANGLE, pitch) - 65536);
     if (period < 0) period = 0;
     if (period > 0x7FF) period = 0x7FF;
     return period;
 }
 
+/* =====================================================================
+ * Vibrato LFO
+ *
+ * One LFO per instance, evaluated once per voice update and shared by all
+ * voices. Phase is a 32-bit accumulator; output is Q15 (+/-32767).
+ * ===================================================================== */
+
+#define LFO_TABLE_BITS 8
+#define LFO_TABLE_SIZE (1 << LFO_TABLE_BITS)
+
+/* One sine cycle in Q15, plus a guard point for interpolation */
+static int16_t g_lfo_sine[LFO_TABLE_SIZE + 1];
+static int g_lfo_tables_ready = 0;
+
+static void lfo_tables_init(void) {
+    if (g_lfo_tables_ready) return;
+    for (int i = 0; i <= LFO_TABLE_SIZE; i++) {
+        g_lfo_sine[i] = (int16_t)lrint(sin(2.0 * M_PI * i / LFO_TABLE_SIZE) * 32767.0);
+    }
+    g_lfo_tables_ready = 1;
+}
+
+/* LFO output at the current phase (Q15). All shapes start at the
+ * centre or top of their cycle and rise through the first quarter. */
+static int32_t lfo_value(const chiptune_instance_t *inst, int shape) {
+    uint32_t phase = inst->lfo_phase;
+    switch (shape) {
+        case LFO_TRIANGLE: {
+            int32_t u = (int32_t)((phase + 0x40000000u) >> 16);
+            int32_t v = 32768 - 2 * abs(u - 32768);
+            return v > 32767 ? 32767 : v;
+        }
+        case LFO_SQUARE:
+            return (phase < 0x80000000u) ? 32767 : -32767;
+        case LFO_SAMPLE_HOLD:
+            return inst->lfo_hold;
+        case LFO_SINE:
+        default: {
+            int idx = (int)(phase >> (32 - LFO_TABLE_BITS));
+            int32_t frac = (int32_t)((phase >> (16 - LFO_TABLE_BITS)) & 0xFFFF);
+            int32_t a = g_lfo_sine[idx];
+            int32_t b = g_lfo_sine[idx + 1];
+            return a + (((b - a) * frac) >> 16);
+        }
+    }
+}
+
+/* Advance the LFO by a block; S&H picks a new value each cycle */
+static void lfo_advance(chiptune_instance_t *inst, float rate_hz, int frames) {
+    if (rate_hz <= 0.0f) return;
+    uint32_t inc = (uint32_t)(rate_hz * (4294967296.0f / (float)inst->sample_rate));
+    uint64_t next = (uint64_t)inst->lfo_phase + (uint64_t)inc * (uint32_t)frames;
+    if (next >> 32) {
+        uint32_t x = inst->lfo_rand;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        inst->lfo_rand = x;
+        inst->lfo_hold = (int32_t)(x >> 16) - 32768;
+        if (inst->lfo_hold < -32767) inst->lfo_hold = -32767;
+    }
+    inst->lfo_phase = (uint32_t)next;
+}
+
+/* =====================================================================
+ * Modulation control rate
+ *
+ * At the default block rate, voices are updated once per render chunk.
+ * The other rates update them on a tick that runs independently of the
+ * host block size, every N samples or at a game driver's 60/240 Hz.
+ * ===================================================================== */
+
+/* Tick period in Q16 samples, 0 for block rate */
+static uint32_t ctrl_period_q16(const chiptune_instance_t *inst, int rate) {
+    switch (rate) {
+        case CTRL_64:    return 64u << 16;
+        case CTRL_32:    return 32u << 16;
+        case CTRL_16:    return 16u << 16;
+        case CTRL_60HZ:  return (uint32_t)(((uint64_t)inst->sample_rate << 16) / 60);
+        case CTRL_240HZ: return (uint32_t)(((uint64_t)inst->sample_rate << 16) / 240);
+        case CTRL_BLOCK:
+        default:         return 0;
+    }
+}
+
+/* Restart ticking, e.g. after the rate changed: the next tick is now */
+static void ctrl_reset(chiptune_instance_t *inst, int rate) {
+    inst->ctrl_rate = rate;
+    inst->ctrl_countdown = 0;
+    inst->ctrl_frac = 0;
+    inst->ctrl_elapsed = 0;
+    for (int i = 0; i < MAX_VOICES; i++) {
+        inst->voices[i].ctrl_ahead = 0;
+    }
+}
+
+/* Schedule the tick after the one just taken */
+static void ctrl_next_tick(chiptune_instance_t *inst, uint32_t period_q16) {
+    inst->ctrl_frac += period_q16;
+    inst->ctrl_countdown = (int)(inst->ctrl_frac >> 16);
+    inst->ctrl_frac &= 0xFFFF;
+    inst->ctrl_elapsed = 0;
+}
+
 /* NES noise period lookup: MIDI note to noise period index (0=highest pitch, 15=lowest)
  * Move pads send notes 68-99 (32 notes). Spread 16 periods across this range
  * so every 2 adjacent pads get a different pitch. */
@@ -397,19 +867,17 @@ static int nes_noise_period_from_note(int note) {
     return idx;
 }
 
-/* GB square frequency register from frequency: reg = 2048 - (131072 / freq) */
-static int gb_square_freq_reg(float freq) {
-    if (freq < 1.0f) freq = 1.0f;
-    int reg = (int)(2048.0f - 131072.0f / freq + 0.5f);
+/* GB square frequency register: reg = 2048 - (131072 / freq) */
+static int gb_square_freq_reg(int32_t pitch) {
+    int reg = 2048 - Q16_ROUND(pitch_period_q16(PERIOD_GB_SQUARE, pitch));
     if (reg < 0) reg = 0;
     if (reg > 2047) reg = 2047;
     return reg;
 }
 
-/* GB wave frequency register from frequency: reg = 2048 - (65536 / freq) */
-static int gb_wave_freq_reg(float freq) {
-    if (freq < 1.0f) freq = 1.0f;
-    int reg = (int)(2048.0f - 65536.0f / freq + 0.5f);
+/* GB wave frequency register: reg = 2048 - (65536 / freq) */
+static int gb_wave_freq_reg(int32_t pitch) {
+    int reg = 2048 - Q16_ROUND(pitch_period_q16(PERIOD_GB_WAVE, pitch));
     if (reg < 0) reg = 0;
     if (reg > 2047) reg = 2047;
     return reg;
@@ -448,155 +916,144 @@ static void gb_noise_params_from_note(int note, int short_mode, uint8_t *out_reg
     *out_reg = (uint8_t)((shift << 4) | (short_mode ? 0x08 : 0x00) | (div_code & 0x07));
 }
 
-/* JSON helpers (minimal, same pattern as braids) */
-static int json_get_number(const char *json, const char *key, float *out) {
-    char search[64];
-    snprintf(search, sizeof(search), "\"%s\":", key);
-    const char *pos = strstr(json, search);
-    if (!pos) return -1;
-    pos += strlen(search);
-    while (*pos == ' ') pos++;
-    *out = (float)atof(pos);
-    return 0;
-}
-
-static int json_get_string(const char *json, const char *key, char *out, int out_len) {
-    char search[64];
-    snprintf(search, sizeof(search), "\"%s\":", key);
-    const char *pos = strstr(json, search);
-    if (!pos) return -1;
-    pos += strlen(search);
-    while (*pos == ' ') pos++;
-    if (*pos != '"') return -1;
-    pos++;
-    int i = 0;
-    while (*pos && *pos != '"' && i < out_len - 1) {
-        out[i++] = *pos++;
-    }
-    out[i] = '\0';
-    return i;
-}
-
 /* =====================================================================
- * Envelope functions
+ * Register shadows
+ *
+ * Each write_register call makes the emulator run up to the write time,
+ * so rewriting unchanged volume/period registers every block splits the
+ * oscillator loops for nothing. Writes that equal the last value written
+ * are dropped, except for registers where the write itself has an effect
+ * (length/phase reloads, triggers, channel enables).
  * ===================================================================== */
 
-static void env_init(voice_envelope_t *env) {
-    env->level = 0.0f;
-    env->stage = ENV_IDLE;
-    env->attack_inc = 0.0f;
-    env->decay_dec = 0.0f;
-    env->sustain_level = 0.0f;
-    env->release_dec = 0.0f;
-}
-
-static void env_configure(voice_envelope_t *env, int attack_param, int decay_param,
-                           int sustain_param, int release_param) {
-    /* Attack: param 0 = instant, 1-15 = progressively slower
-     * At param=0, instant attack (1 sample). At param=15, ~0.25 seconds. */
-    if (attack_param <= 0) {
-        env->attack_inc = 1.0f; /* instant */
-    } else {
-        float attack_samples = attack_param * (SAMPLE_RATE / 60.0f);
-        env->attack_inc = 1.0f / attack_samples;
-    }
-
-    /* Decay: param 0 = instant, 1-15 = progressively slower
-     * At param=0, instant. At param=15, ~1 second. */
-    if (decay_param <= 0) {
-        env->decay_dec = 1.0f; /* instant */
-    } else {
-        float decay_samples = decay_param * (SAMPLE_RATE / 15.0f);
-        env->decay_dec = 1.0f / decay_samples;
-    }
+static void shadow_invalidate(chiptune_instance_t *inst) {
+    for (int i = 0; i < NES_SHADOW_REGS; i++) inst->nes_shadow[i] = -1;
+    for (int i = 0; i < GB_SHADOW_REGS; i++) inst->gb_shadow[i] = -1;
+    inst->gb_silenced = 0;
+}
 
-    /* Sustain: 0 = no sustain (AD envelope), 15 = full level */
-    env->sustain_level = (float)sustain_param / 15.0f;
+static int nes_reg_has_side_effects(unsigned addr) {
+    /* $4003/$4007/$400B/$400F reload length and restart the sequencer */
+    if (addr < 0x4010) return (addr & 3) == 3;
+    /* $4011 loads the DMC DAC, which playback moves on from */
+    return addr == 0x4011 || addr == 0x4015 || addr == 0x4017;
+}
 
-    /* Release: param 0 = instant, 1-15 = progressively slower
-     * At param=0, instant. At param=15, ~1 second. */
-    if (release_param <= 0) {
-        env->release_dec = 1.0f; /* instant */
-    } else {
-        float release_samples = release_param * (SAMPLE_RATE / 15.0f);
-        env->release_dec = 1.0f / release_samples;
+static void nes_write(chiptune_instance_t *inst, int time, unsigned addr, uint8_t data) {
+    int idx = (int)addr - NES_SHADOW_BASE;
+    if (idx >= 0 && idx < NES_SHADOW_REGS) {
+        if (inst->nes_shadow[idx] == data && !nes_reg_has_side_effects(addr)) {
+            inst->reg_writes_suppressed++;
+            return;
+        }
+        inst->nes_shadow[idx] = data;
     }
+    inst->nes_apu.write_register(time, addr, data);
+    inst->reg_writes_issued++;
 }
 
-static void env_gate_on(voice_envelope_t *env) {
-    env->stage = ENV_ATTACK;
-    /* Don't reset level - allows retriggering */
+/* GB channel (0-3) owning a register, or -1 for control/wave RAM */
+static int gb_reg_channel(unsigned addr) {
+    if (addr < 0xFF10 || addr > 0xFF23) return -1;
+    return (int)(addr - 0xFF10) / 5;
 }
 
-static void env_gate_off(voice_envelope_t *env) {
-    if (env->stage != ENV_IDLE) {
-        env->stage = ENV_RELEASE;
+static int gb_reg_has_side_effects(unsigned addr, uint8_t data) {
+    switch (addr) {
+        case 0xFF14: case 0xFF19: case 0xFF1E: case 0xFF23:
+            return data & 0x80;  /* trigger */
+        case 0xFF26:
+            return 1;            /* power */
+        default:
+            return 0;
     }
 }
 
-/* Advance envelope by one sample, return level 0.0-1.0 */
-static float env_process(voice_envelope_t *env) {
-    switch (env->stage) {
-        case ENV_ATTACK:
-            env->level += env->attack_inc;
-            if (env->level >= 1.0f) {
-                env->level = 1.0f;
-                env->stage = ENV_DECAY;
-            }
-            break;
-        case ENV_DECAY:
-            env->level -= env->decay_dec;
-            if (env->level <= env->sustain_level) {
-                env->level = env->sustain_level;
-                if (env->sustain_level > 0.0f) {
-                    env->stage = ENV_SUSTAIN;
-                } else {
-                    env->stage = ENV_IDLE; /* AD mode: no sustain */
-                }
-            }
-            break;
-        case ENV_SUSTAIN:
-            /* Hold at sustain level until gate off */
-            break;
-        case ENV_RELEASE:
-            env->level -= env->release_dec;
-            if (env->level <= 0.0f) {
-                env->level = 0.0f;
-                env->stage = ENV_IDLE;
-            }
-            break;
-        case ENV_IDLE:
-        default:
-            env->level = 0.0f;
-            break;
+static void gb_write(chiptune_instance_t *inst, unsigned addr, uint8_t data, unsigned time) {
+    int idx = (int)addr - GB_SHADOW_BASE;
+    if (idx >= 0 && idx < GB_SHADOW_REGS) {
+        if (inst->gb_shadow[idx] == data && !gb_reg_has_side_effects(addr, data)) {
+            inst->reg_writes_suppressed++;
+            return;
+        }
+        inst->gb_shadow[idx] = data;
     }
-    return env->level;
+    int ch = gb_reg_channel(addr);
+    if (ch >= 0) inst->gb_silenced &= (uint8_t)~(1 << ch);
+    gb_apu_wrapper_write(inst->gb_apu, addr, data, time);
+    inst->reg_writes_issued++;
 }
 
 /* =====================================================================
  * APU initialization helpers
  * ===================================================================== */
 
+/* Take sample rate and block size from the host */
+static void init_audio_format(chiptune_instance_t *inst) {
+    inst->sample_rate = DEFAULT_SAMPLE_RATE;
+    inst->chunk_frames = DEFAULT_FRAMES_PER_BLOCK;
+    if (g_host && g_host->sample_rate > 0) inst->sample_rate = g_host->sample_rate;
+    if (g_host && g_host->frames_per_block > 0) inst->chunk_frames = g_host->frames_per_block;
+    if (inst->chunk_frames > MAX_CHUNK_FRAMES) inst->chunk_frames = MAX_CHUNK_FRAMES;
+}
+
+/* Blip_Buffer length in msec: BLIP_BUFFER_BLOCKS render chunks, rounded up.
+ * The library default is ~65000 samples per buffer, of which we would only
+ * ever use one chunk's worth. */
+static int blip_buffer_msec(const chiptune_instance_t *inst) {
+    return (inst->chunk_frames * BLIP_BUFFER_BLOCKS * 1000 + inst->sample_rate - 1) /
+           inst->sample_rate + 1;
+}
+
+/* Nes_Apu DMC reader: bytes of the current sample, read straight from the
+ * shared mapping. Past its end (or with none) it reads a flat pattern. */
+static int nes_dmc_read(void *user, cpu_addr_t addr) {
+    const dmc_sample_t *s = ((chiptune_instance_t *)user)->dmc_sample;
+    unsigned offset = (unsigned)addr - 0xC000u;
+    if (!s || offset >= (unsigned)s->len) return 0x55;
+    return s->data[offset];
+}
+
+/* Allocate and initialize both APUs. Only called from create_instance. */
 static void init_nes_apu(chiptune_instance_t *inst) {
     inst->nes_blip.clock_rate(NES_CPU_CLOCK);
-    inst->nes_blip.set_sample_rate(SAMPLE_RATE);
+    if (inst->nes_blip.set_sample_rate(inst->sample_rate, blip_buffer_msec(inst))) {
+        plugin_log("NES Blip_Buffer allocation failed");
+    }
     inst->nes_blip.clear();
     inst->nes_apu.set_output(&inst->nes_blip);
+    inst->nes_apu.dmc_reader(nes_dmc_read, inst);
     inst->nes_apu.reset(false, 0);
     /* Enable all channels */
     inst->nes_apu.write_register(0, 0x4015, 0x0F);
 }
 
 static void init_gb_apu(chiptune_instance_t *inst) {
-    if (inst->gb_apu) {
-        gb_apu_wrapper_destroy(inst->gb_apu);
+    inst->gb_apu = gb_apu_wrapper_create(inst->sample_rate, blip_buffer_msec(inst));
+    if (!inst->gb_apu) {
+        plugin_log("GB APU allocation failed");
     }
-    inst->gb_apu = gb_apu_wrapper_create(SAMPLE_RATE);
     /* Master enable, volume, and routing are set by the wrapper */
 }
 
+/* Soft reset of both APUs for preset changes and state restore: registers
+ * and oscillators are reinitialized in place and only the samples waiting
+ * to be read are cleared. No allocation, so safe near the audio thread. */
+static void reset_apus(chiptune_instance_t *inst) {
+    inst->nes_blip.clear(false);
+    inst->nes_apu.reset(false, 0);
+    inst->nes_apu.write_register(0, 0x4015, 0x0F);
+    inst->dmc_playing = 0;
+
+    gb_apu_wrapper_reset(inst->gb_apu);
+    shadow_invalidate(inst);
+}
+
 /* =====================================================================
  * Preset application
+ *
+ * Presets are applied to the control thread's copy of the parameters
+ * and reach the audio thread through params_publish.
  * ===================================================================== */
 
 static void apply_preset(chiptune_instance_t *inst, int idx) {
@@ -604,24 +1061,26 @@ static void apply_preset(chiptune_instance_t *inst, int idx) {
 
     const chiptune_preset_t *p = &g_factory_presets[idx];
 
-    inst->chip = p->chip;
-    inst->params[P_DUTY] = (float)p->duty;
-    inst->params[P_ENV_ATTACK] = (float)p->env_attack;
-    inst->params[P_ENV_DECAY] = (float)p->env_decay;
-    inst->params[P_ENV_SUSTAIN] = (float)p->env_sustain;
-    inst->params[P_ENV_RELEASE] = (float)p->env_release;
-    inst->params[P_SWEEP] = (float)p->sweep;
-    inst->params[P_VIBRATO_DEPTH] = (float)p->vibrato_depth;
-    inst->params[P_VIBRATO_RATE] = (float)p->vibrato_rate;
-    inst->params[P_NOISE_MODE] = (float)p->noise_mode;
-    inst->params[P_WAVETABLE] = (float)p->wavetable_idx;
-    inst->params[P_CHANNEL_MASK] = (float)p->channel_mask;
-    inst->params[P_DETUNE] = (float)p->detune;
-    inst->params[P_VOLUME] = (float)p->volume;
-    inst->params[P_OCTAVE_TRANSPOSE] = 0.0f;
-    inst->params[P_ALLOC_MODE] = (float)p->alloc_mode;
-    inst->params[P_PITCH_ENV_DEPTH] = (float)p->pitch_env_depth;
-    inst->params[P_PITCH_ENV_SPEED] = (float)p->pitch_env_speed;
+    inst->ui.chip = p->chip;
+    inst->ui.params[P_DUTY] = (float)p->duty;
+    inst->ui.params[P_ENV_ATTACK] = (float)p->env_attack;
+    inst->ui.params[P_ENV_DECAY] = (float)p->env_decay;
+    inst->ui.params[P_ENV_SUSTAIN] = (float)p->env_sustain;
+    inst->ui.params[P_ENV_RELEASE] = (float)p->env_release;
+    inst->ui.params[P_SWEEP] = (float)p->sweep;
+    inst->ui.params[P_VIBRATO_DEPTH] = (float)p->vibrato_depth;
+    inst->ui.params[P_VIBRATO_RATE] = (float)p->vibrato_rate;
+    inst->ui.params[P_NOISE_MODE] = (float)p->noise_mode;
+    inst->ui.params[P_WAVETABLE] = (float)p->wavetable_idx;
+    inst->ui.params[P_CHANNEL_MASK] = (float)p->channel_mask;
+    inst->ui.params[P_DETUNE] = (float)p->detune;
+    inst->ui.params[P_VOLUME] = (float)p->volume;
+    inst->ui.params[P_OCTAVE_TRANSPOSE] = 0.0f;
+    inst->ui.params[P_VIBRATO_SHAPE] = LFO_SINE;
+    inst->ui.params[P_CONTROL_RATE] = CTRL_BLOCK;
+    inst->ui.params[P_ALLOC_MODE] = (float)p->alloc_mode;
+    inst->ui.params[P_PITCH_ENV_DEPTH] = (float)p->pitch_env_depth;
+    inst->ui.params[P_PITCH_ENV_SPEED] = (float)p->pitch_env_speed;
 
     inst->current_preset = idx;
     snprintf(inst->preset_name, sizeof(inst->preset_name), "%s", p->name);
@@ -638,14 +1097,22 @@ static void kill_all_voices(chiptune_instance_t *inst) {
     }
 }
 
+/* Channels voices can use: the four tone channels, plus the DMC on the
+ * NES when there are samples for it */
+static int voice_channel_count(const chiptune_instance_t *inst) {
+    if (inst->chip == CHIP_NES && inst->dmc_bank && inst->dmc_bank->count > 0) return 5;
+    return 4;
+}
+
 /* Determine which APU channel to assign for a new voice */
 static int pick_channel(chiptune_instance_t *inst, int note) {
     int mask = (int)inst->params[P_CHANNEL_MASK];
     int alloc = (int)inst->params[P_ALLOC_MODE];
+    int channels = voice_channel_count(inst);
 
     if (alloc == ALLOC_LOCKED) {
         /* Find first available channel in mask not currently in use */
-        for (int ch = 0; ch < 4; ch++) {
+        for (int ch = 0; ch < channels; ch++) {
             if (!(mask & (1 << ch))) continue;
             int in_use = 0;
             for (int v = 0; v < MAX_VOICES; v++) {
@@ -670,7 +1137,7 @@ static int pick_channel(chiptune_instance_t *inst, int note) {
         }
         if (oldest_voice >= 0) return inst->voices[oldest_voice].channel_idx;
         /* Fallback */
-        for (int ch = 0; ch < 4; ch++) {
+        for (int ch = 0; ch < channels; ch++) {
             if (mask & (1 << ch)) return ch;
         }
         return 0;
@@ -678,13 +1145,19 @@ static int pick_channel(chiptune_instance_t *inst, int note) {
 
     if (alloc == ALLOC_LEAD) {
         /* Monophonic: always use first channel in mask */
-        for (int ch = 0; ch < 4; ch++) {
+        for (int ch = 0; ch < channels; ch++) {
             if (mask & (1 << ch)) return ch;
         }
         return 0;
     }
 
     /* AUTO mode */
+    /* DMC for the keys that have a sample */
+    if (channels > CHAN_DMC && (mask & 0x10) &&
+        note >= DMC_BASE_NOTE && note < DMC_BASE_NOTE + inst->dmc_bank->count) {
+        return CHAN_DMC;
+    }
+
     /* Noise channel for very high notes */
     if (note > 96 && (mask & 0x08)) {
         return 3; /* noise */
@@ -727,11 +1200,13 @@ static int pick_channel(chiptune_instance_t *inst, int note) {
         if (!in_use) return 3;
     }
 
-    /* All busy - steal oldest on a pulse channel */
+    /* All busy - steal oldest on a pulse channel (never the DMC, which
+     * only plays its own keys) */
     int oldest_voice = -1;
     int oldest_age = 0x7FFFFFFF;
     for (int v = 0; v < MAX_VOICES; v++) {
-        if (inst->voices[v].active && inst->voices[v].age < oldest_age) {
+        if (inst->voices[v].active && inst->voices[v].age < oldest_age &&
+            inst->voices[v].channel_idx != CHAN_DMC) {
             oldest_age = inst->voices[v].age;
             oldest_voice = v;
         }
@@ -778,43 +1253,50 @@ static int find_voice_for_note(chiptune_instance_t *inst, int note) {
     return -1;
 }
 
+static int any_voice_active(chiptune_instance_t *inst) {
+    for (int i = 0; i < MAX_VOICES; i++) {
+        if (inst->voices[i].active) return 1;
+    }
+    return 0;
+}
+
 /* =====================================================================
  * NES APU register writing
  * ===================================================================== */
 
 static void nes_write_pulse(chiptune_instance_t *inst, int chan_idx, int time,
-                            int duty, int vol, float freq, int do_trigger) {
+                            int duty, int vol, int32_t pitch, int do_trigger) {
     /* chan_idx: 0 = pulse1 ($4000-$4003), 1 = pulse2 ($4004-$4007) */
     uint16_t base = (chan_idx == 0) ? 0x4000 : 0x4004;
 
-    int period = nes_pulse_period(freq);
+    int period = nes_pulse_period(pitch);
     /* $4000/$4004: duty | length counter halt | constant volume | volume */
     uint8_t reg0 = (uint8_t)(((duty & 0x03) << 6) | 0x30 | (vol & 0x0F));
 
-    inst->nes_apu.write_register(time, base + 0, reg0);
+    nes_write(inst, time, base + 0, reg0);
     /* $4002/$4006: period low (safe to write every block) */
-    inst->nes_apu.write_register(time + 1, base + 2, (uint8_t)(period & 0xFF));
+    nes_write(inst, time + 1, base + 2, (uint8_t)(period & 0xFF));
     if (do_trigger) {
         /* $4001/$4005: sweep disabled */
-        inst->nes_apu.write_register(time + 2, base + 1, 0x00);
+        nes_write(inst, time + 2, base + 1, 0x00);
         /* $4003/$4007: length counter load | period high
          * This resets the phase sequencer - only do it on note-on */
-        inst->nes_apu.write_register(time + 3, base + 3,
+        nes_write(inst, time + 3, base + 3,
             (uint8_t)(0xF8 | ((period >> 8) & 0x07)));
     }
 }
 
-static void nes_write_triangle(chiptune_instance_t *inst, int time, int gate, float freq, int do_trigger) {
-    int period = nes_triangle_period(freq);
+static void nes_write_triangle(chiptune_instance_t *inst, int time, int gate, int32_t pitch, int do_trigger) {
+    int period = nes_triangle_period(pitch);
     /* $4008: linear counter (0x7F = max length, bit 7 = control) */
     uint8_t reg8 = gate ? 0xFF : 0x80;
 
-    inst->nes_apu.write_register(time, 0x4008, reg8);
+    nes_write(inst, time, 0x4008, reg8);
     /* $400A: period low (safe to write every block) */
-    inst->nes_apu.write_register(time + 1, 0x400A, (uint8_t)(period & 0xFF));
+    nes_write(inst, time + 1, 0x400A, (uint8_t)(period & 0xFF));
     if (do_trigger) {
         /* $400B: length counter load | period high (resets linear counter) */
-        inst->nes_apu.write_register(time + 2, 0x400B,
+        nes_write(inst, time + 2, 0x400B,
             (uint8_t)(0xF8 | ((period >> 8) & 0x07)));
     }
 }
@@ -826,27 +1308,53 @@ static void nes_write_noise(chiptune_instance_t *inst, int time, int vol, int no
     /* $400E: mode | period */
     uint8_t regE = (uint8_t)((short_mode ? 0x80 : 0x00) | (period_idx & 0x0F));
 
-    inst->nes_apu.write_register(time, 0x400C, regC);
-    inst->nes_apu.write_register(time + 1, 0x400E, regE);
+    nes_write(inst, time, 0x400C, regC);
+    nes_write(inst, time + 1, 0x400E, regE);
     if (do_trigger) {
         /* $400F: length counter load */
-        inst->nes_apu.write_register(time + 2, 0x400F, 0xF8);
+        nes_write(inst, time + 2, 0x400F, 0xF8);
     }
 }
 
+/* DMC has no volume or pitch control: a note starts the sample for its
+ * key, which plays to its end unless the voice ends first */
+static void nes_write_dmc(chiptune_instance_t *inst, int time, int note) {
+    const dmc_bank_t *bank = inst->dmc_bank;
+    int idx = (note - DMC_BASE_NOTE) % bank->count;
+    if (idx < 0) idx += bank->count;
+    const dmc_sample_t *s = &bank->samples[idx];
+
+    /* Stop first: enabling only starts a sample when none is playing */
+    nes_write(inst, time, 0x4015, 0x0F);
+    inst->dmc_sample = s;
+    nes_write(inst, time + 1, 0x4010, DMC_RATE);       /* no IRQ, no loop */
+    nes_write(inst, time + 2, 0x4011, DMC_MIDPOINT);
+    nes_write(inst, time + 3, 0x4012, 0x00);           /* start at $C000 */
+    nes_write(inst, time + 4, 0x4013, (uint8_t)((s->len - 1) / 16));
+    nes_write(inst, time + 5, 0x4015, 0x1F);
+    inst->dmc_playing = 1;
+}
+
 static void nes_silence_channel(chiptune_instance_t *inst, int chan_idx, int time) {
     switch (chan_idx) {
         case 0:
-            inst->nes_apu.write_register(time, 0x4000, 0x30); /* vol=0, constant */
+            nes_write(inst, time, 0x4000, 0x30); /* vol=0, constant */
             break;
         case 1:
-            inst->nes_apu.write_register(time, 0x4004, 0x30);
+            nes_write(inst, time, 0x4004, 0x30);
             break;
         case 2:
-            inst->nes_apu.write_register(time, 0x4008, 0x80); /* halt, counter=0 */
+            nes_write(inst, time, 0x4008, 0x80); /* halt, counter=0 */
             break;
         case 3:
-            inst->nes_apu.write_register(time, 0x400C, 0x30);
+            nes_write(inst, time, 0x400C, 0x30);
+            break;
+        case CHAN_DMC:
+            /* Clearing the enable bit ends the sample */
+            if (inst->dmc_playing) {
+                nes_write(inst, time, 0x4015, 0x0F);
+                inst->dmc_playing = 0;
+            }
             break;
     }
 }
@@ -862,48 +1370,58 @@ static void gb_load_wavetable(chiptune_instance_t *inst, int wave_idx, unsigned
      * Use the same time value for all writes — blargg's emulator processes
      * them in call order regardless, and incrementing time would advance
      * last_time, causing asserts if render_block starts at time 0. */
-    gb_apu_wrapper_write(inst->gb_apu, 0xFF1A, 0x00, time);
+    gb_write(inst, 0xFF1A, 0x00, time);
     /* Write 16 bytes of wave RAM ($FF30-$FF3F) */
     for (int i = 0; i < 16; i++) {
-        gb_apu_wrapper_write(inst->gb_apu, 0xFF30 + i, g_wavetables[wave_idx][i], time);
+        gb_write(inst, 0xFF30 + i, g_wavetables[wave_idx][i], time);
     }
     /* Re-enable wave channel */
-    gb_apu_wrapper_write(inst->gb_apu, 0xFF1A, 0x80, time);
+    gb_write(inst, 0xFF1A, 0x80, time);
 }
 
 static void gb_write_square1(chiptune_instance_t *inst, unsigned time,
-                             int duty, int vol, float freq, int sweep, int do_trigger) {
-    int freq_reg = gb_square_freq_reg(freq);
+                             int duty, int vol, int32_t pitch, int sweep, int do_trigger) {
+    int freq_reg = gb_square_freq_reg(pitch);
     /* Always write volume + freq; trigger only on note-on.
      * Writing FF12 (envelope) requires re-trigger to take effect on real HW,
      * but blargg's emulator applies it immediately. */
-    gb_apu_wrapper_write(inst->gb_apu, 0xFF12, (uint8_t)(((vol & 0x0F) << 4) | 0x00), time);
-    gb_apu_wrapper_write(inst->gb_apu, 0xFF13, (uint8_t)(freq_reg & 0xFF), time + 1);
+    gb_write(inst, 0xFF12, (uint8_t)(((vol & 0x0F) << 4) | 0x00), time);
+    /* The sweep unit changes the frequency behind our back, so the shadow
+     * can't tell whether this write is redundant */
+    if (sweep > 0) inst->gb_shadow[0xFF13 - GB_SHADOW_BASE] = -1;
+    gb_write(inst, 0xFF13, (uint8_t)(freq_reg & 0xFF), time + 1);
     if (do_trigger) {
         uint8_t sweep_reg = 0x00;
         if (sweep > 0) {
             sweep_reg = (uint8_t)(((sweep & 0x07) << 4) | 0x02);
         }
-        gb_apu_wrapper_write(inst->gb_apu, 0xFF10, sweep_reg, time + 2);
-        gb_apu_wrapper_write(inst->gb_apu, 0xFF11, (uint8_t)(((duty & 0x03) << 6) | 0x3F), time + 3);
-        gb_apu_wrapper_write(inst->gb_apu, 0xFF14, (uint8_t)(0x80 | ((freq_reg >> 8) & 0x07)), time + 4);
+        gb_write(inst, 0xFF10, sweep_reg, time + 2);
+        gb_write(inst, 0xFF11, (uint8_t)(((duty & 0x03) << 6) | 0x3F), time + 3);
+        gb_write(inst, 0xFF14, (uint8_t)(0x80 | ((freq_reg >> 8) & 0x07)), time + 4);
+    } else if (sweep == 0) {
+        /* Freq high without trigger, so pitch modulation can cross a
+         * 256-step boundary. With sweep on, the sweep unit owns it. */
+        gb_write(inst, 0xFF14, (uint8_t)((freq_reg >> 8) & 0x07), time + 1);
     }
 }
 
 static void gb_write_square2(chiptune_instance_t *inst, unsigned time,
-                             int duty, int vol, float freq, int do_trigger) {
-    int freq_reg = gb_square_freq_reg(freq);
+                             int duty, int vol, int32_t pitch, int do_trigger) {
+    int freq_reg = gb_square_freq_reg(pitch);
     /* Always write volume + freq */
-    gb_apu_wrapper_write(inst->gb_apu, 0xFF17, (uint8_t)(((vol & 0x0F) << 4) | 0x00), time);
-    gb_apu_wrapper_write(inst->gb_apu, 0xFF18, (uint8_t)(freq_reg & 0xFF), time + 1);
+    gb_write(inst, 0xFF17, (uint8_t)(((vol & 0x0F) << 4) | 0x00), time);
+    gb_write(inst, 0xFF18, (uint8_t)(freq_reg & 0xFF), time + 1);
     if (do_trigger) {
-        gb_apu_wrapper_write(inst->gb_apu, 0xFF16, (uint8_t)(((duty & 0x03) << 6) | 0x3F), time + 2);
-        gb_apu_wrapper_write(inst->gb_apu, 0xFF19, (uint8_t)(0x80 | ((freq_reg >> 8) & 0x07)), time + 3);
+        gb_write(inst, 0xFF16, (uint8_t)(((duty & 0x03) << 6) | 0x3F), time + 2);
+        gb_write(inst, 0xFF19, (uint8_t)(0x80 | ((freq_reg >> 8) & 0x07)), time + 3);
+    } else {
+        /* Freq high without trigger */
+        gb_write(inst, 0xFF19, (uint8_t)((freq_reg >> 8) & 0x07), time + 1);
     }
 }
 
-static void gb_write_wave(chiptune_instance_t *inst, unsigned time, int vol, float freq, int do_trigger) {
-    int freq_reg = gb_wave_freq_reg(freq);
+static void gb_write_wave(chiptune_instance_t *inst, unsigned time, int vol, int32_t pitch, int do_trigger) {
+    int freq_reg = gb_wave_freq_reg(pitch);
     /* GB wave volume: 0=mute, 1=100%, 2=50%, 3=25% */
     int wave_vol;
     if (vol >= 12) wave_vol = 1;       /* 100% */
@@ -912,17 +1430,17 @@ static void gb_write_wave(chiptune_instance_t *inst, unsigned time, int vol, flo
     else wave_vol = 0;                 /* mute */
 
     /* $FF1C: volume select (safe every block) */
-    gb_apu_wrapper_write(inst->gb_apu, 0xFF1C, (uint8_t)((wave_vol & 0x03) << 5), time);
+    gb_write(inst, 0xFF1C, (uint8_t)((wave_vol & 0x03) << 5), time);
     /* $FF1D: freq low (safe every block) */
-    gb_apu_wrapper_write(inst->gb_apu, 0xFF1D, (uint8_t)(freq_reg & 0xFF), time + 1);
+    gb_write(inst, 0xFF1D, (uint8_t)(freq_reg & 0xFF), time + 1);
     if (do_trigger) {
         /* $FF1A: DAC enable */
-        gb_apu_wrapper_write(inst->gb_apu, 0xFF1A, 0x80, time + 2);
+        gb_write(inst, 0xFF1A, 0x80, time + 2);
         /* $FF1E: trigger | freq high */
-        gb_apu_wrapper_write(inst->gb_apu, 0xFF1E, (uint8_t)(0x80 | ((freq_reg >> 8) & 0x07)), time + 3);
+        gb_write(inst, 0xFF1E, (uint8_t)(0x80 | ((freq_reg >> 8) & 0x07)), time + 3);
     } else {
         /* Just update freq high without trigger */
-        gb_apu_wrapper_write(inst->gb_apu, 0xFF1E, (uint8_t)((freq_reg >> 8) & 0x07), time + 2);
+        gb_write(inst, 0xFF1E, (uint8_t)((freq_reg >> 8) & 0x07), time + 2);
     }
 }
 
@@ -931,32 +1449,92 @@ static void gb_write_noise(chiptune_instance_t *inst, unsigned time, int vol, in
     gb_noise_params_from_note(note, short_mode, &poly_reg);
 
     /* Always write volume */
-    gb_apu_wrapper_write(inst->gb_apu, 0xFF21, (uint8_t)(((vol & 0x0F) << 4) | 0x00), time);
-    gb_apu_wrapper_write(inst->gb_apu, 0xFF22, poly_reg, time + 1);
+    gb_write(inst, 0xFF21, (uint8_t)(((vol & 0x0F) << 4) | 0x00), time);
+    gb_write(inst, 0xFF22, poly_reg, time + 1);
     if (do_trigger) {
-        gb_apu_wrapper_write(inst->gb_apu, 0xFF20, 0x3F, time + 2);
-        gb_apu_wrapper_write(inst->gb_apu, 0xFF23, 0x80, time + 3);
+        gb_write(inst, 0xFF20, 0x3F, time + 2);
+        gb_write(inst, 0xFF23, 0x80, time + 3);
     }
 }
 
 static void gb_silence_channel(chiptune_instance_t *inst, int chan_idx, unsigned time) {
+    /* Silencing retriggers at volume 0; once done, repeating it is a no-op
+     * until something else is written to the channel */
+    if (inst->gb_silenced & (1 << chan_idx)) {
+        inst->reg_writes_suppressed += (chan_idx == 2) ? 1 : 2;
+        return;
+    }
     switch (chan_idx) {
         case 0: /* square 1 */
-            gb_apu_wrapper_write(inst->gb_apu, 0xFF12, 0x00, time); /* vol=0 */
-            gb_apu_wrapper_write(inst->gb_apu, 0xFF14, 0x80, time + 1); /* retrigger with 0 vol */
+            gb_write(inst, 0xFF12, 0x00, time); /* vol=0 */
+            gb_write(inst, 0xFF14, 0x80, time + 1); /* retrigger with 0 vol */
             break;
         case 1: /* square 2 */
-            gb_apu_wrapper_write(inst->gb_apu, 0xFF17, 0x00, time);
-            gb_apu_wrapper_write(inst->gb_apu, 0xFF19, 0x80, time + 1);
+            gb_write(inst, 0xFF17, 0x00, time);
+            gb_write(inst, 0xFF19, 0x80, time + 1);
             break;
         case 2: /* wave */
-            gb_apu_wrapper_write(inst->gb_apu, 0xFF1C, 0x00, time); /* vol=0 (mute) */
+            gb_write(inst, 0xFF1C, 0x00, time); /* vol=0 (mute) */
             break;
         case 3: /* noise */
-            gb_apu_wrapper_write(inst->gb_apu, 0xFF21, 0x00, time);
-            gb_apu_wrapper_write(inst->gb_apu, 0xFF23, 0x80, time + 1);
+            gb_write(inst, 0xFF21, 0x00, time);
+            gb_write(inst, 0xFF23, 0x80, time + 1);
             break;
     }
+    inst->gb_silenced |= (uint8_t)(1 << chan_idx);
+}
+
+/* =====================================================================
+ * Parameter hand-off
+ *
+ * set_param runs on the control thread while render_block may be running.
+ * Parameter values travel as whole snapshots through a triple buffer, so
+ * neither side ever waits or sees a half-written set; voice, APU and
+ * wavetable changes are deferred to the audio thread as OP_* requests.
+ * ===================================================================== */
+
+static void params_init(chiptune_instance_t *inst) {
+    inst->state_dirty = 1;
+    inst->snap_back = 0;
+    inst->snap_front = 1;
+    inst->snap_latest.store(2, std::memory_order_relaxed);
+    inst->pending_ops.store(0, std::memory_order_relaxed);
+}
+
+/* Control thread: publish the current ui parameters, plus operations to
+ * run before the audio thread next uses them */
+static void params_publish(chiptune_instance_t *inst, uint32_t ops) {
+    inst->state_dirty = 1;
+    inst->snapshots[inst->snap_back] = inst->ui;
+    int prev = inst->snap_latest.exchange(inst->snap_back | SNAPSHOT_NEW,
+                                          std::memory_order_acq_rel);
+    inst->snap_back = prev & ~SNAPSHOT_NEW;
+    if (ops) inst->pending_ops.fetch_or(ops, std::memory_order_release);
+}
+
+/* Audio thread, at a block boundary: take the newest parameters and run
+ * the requested operations. Ops are taken first, so the snapshot taken
+ * after them is at least as new as the change that requested them. */
+static void params_fetch(chiptune_instance_t *inst) {
+    uint32_t ops = inst->pending_ops.exchange(0, std::memory_order_acquire);
+
+    if (inst->snap_latest.load(std::memory_order_relaxed) & SNAPSHOT_NEW) {
+        int prev = inst->snap_latest.exchange(inst->snap_front, std::memory_order_acq_rel);
+        inst->snap_front = prev & ~SNAPSHOT_NEW;
+        const param_snapshot_t *snap = &inst->snapshots[inst->snap_front];
+        /* A new vibrato depth (knob, preset, state) takes over from the wheel */
+        if (snap->params[P_VIBRATO_DEPTH] != inst->params[P_VIBRATO_DEPTH]) {
+            inst->mod_vibrato_depth = -1.0f;
+        }
+        memcpy(inst->params, snap->params, sizeof(inst->params));
+        inst->chip = snap->chip;
+    }
+
+    if (ops & OP_KILL_VOICES) kill_all_voices(inst);
+    if (ops & OP_RESET_APUS) reset_apus(inst);
+    if ((ops & OP_LOAD_WAVETABLE) && inst->chip == CHIP_GB) {
+        gb_load_wavetable(inst, (int)inst->params[P_WAVETABLE], 0);
+    }
 }
 
 /* =====================================================================
@@ -973,24 +1551,46 @@ static void* v2_create_instance(const char *module_dir, const char *json_default
 
     strncpy(inst->module_dir, module_dir, sizeof(inst->module_dir) - 1);
 
+    init_audio_format(inst);
+    shadow_invalidate(inst);
+
     /* Init NES APU */
     init_nes_apu(inst);
 
     /* Init GB APU */
-    inst->gb_apu = NULL;
     init_gb_apu(inst);
 
+    /* DMC samples, mapped once per module directory */
+    inst->dmc_bank = dmc_bank_acquire(inst->module_dir);
+    inst->dmc_sample = NULL;
+    inst->dmc_playing = 0;
+
     /* Init voices */
     for (int i = 0; i < MAX_VOICES; i++) {
         inst->voices[i].active = 0;
         env_init(&inst->voices[i].env);
     }
     inst->voice_age_counter = 0;
-    inst->lfo_phase = 0.0f;
+    inst->lfo_phase = 0;
+    inst->lfo_hold = 0;
+    inst->lfo_rand = 0x2545F491u;
+    ctrl_reset(inst, CTRL_BLOCK);
     inst->pitch_bend_semitones = 0.0f;
+    inst->mod_vibrato_depth = -1.0f;
+    inst->quiescent = 0;
+    inst->settled_blocks = 0;
+    inst->underrun_blocks = 0;
+    inst->overrun_blocks = 0;
+    midi_queue_init(&inst->midi_queue);
+    inst->midi_block_end = 0;
+    inst->render_start_ns.store(0, std::memory_order_relaxed);
+    inst->midi_dropped = 0;
 
     /* Load default preset */
+    params_init(inst);
     apply_preset(inst, 0);
+    params_publish(inst, 0);
+    params_fetch(inst);
 
     plugin_log("Instance created");
     return inst;
@@ -1003,14 +1603,14 @@ static void v2_destroy_instance(void *instance) {
         gb_apu_wrapper_destroy(inst->gb_apu);
         inst->gb_apu = NULL;
     }
+    dmc_bank_release(inst->dmc_bank);
     delete inst;
     plugin_log("Instance destroyed");
 }
 
-static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source) {
-    chiptune_instance_t *inst = (chiptune_instance_t*)instance;
-    if (!inst || len < 2) return;
-    (void)source;
+/* Apply one MIDI message to voice state (render thread) */
+static void handle_midi(chiptune_instance_t *inst, const uint8_t *msg, int len) {
+    if (len < 2) return;
 
     uint8_t status = msg[0] & 0xF0;
     uint8_t data1 = msg[1];
@@ -1066,7 +1666,15 @@ static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source)
             v->age = ++inst->voice_age_counter;
 
             /* Determine channel type */
-            if (chan == 3) {
+            if (chan == CHAN_DMC) {
+                v->channel_type = CHAN_DMC;
+                /* One sample at a time: this hit replaces the last */
+                for (int i = 0; i < MAX_VOICES; i++) {
+                    if (i != vi && inst->voices[i].active && inst->voices[i].channel_idx == CHAN_DMC) {
+                        inst->voices[i].active = 0;
+                    }
+                }
+            } else if (chan == 3) {
                 v->channel_type = CHAN_NOISE;
             } else if (chan == 2) {
                 v->channel_type = (inst->chip == CHIP_NES) ? CHAN_TRIANGLE : CHAN_WAVE;
@@ -1080,7 +1688,7 @@ static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source)
             int sustain = (int)inst->params[P_ENV_SUSTAIN];
             int release = (int)inst->params[P_ENV_RELEASE];
             env_init(&v->env);
-            env_configure(&v->env, attack, decay, sustain, release);
+            env_configure(&v->env, attack, decay, sustain, release, inst->sample_rate);
             env_gate_on(&v->env);
 
             /* Auto-unison: if detune > 0 and both pulse channels available,
@@ -1107,7 +1715,7 @@ static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source)
                     v2->pitch_env = inst->params[P_PITCH_ENV_DEPTH];
                     v2->age = ++inst->voice_age_counter;
                     env_init(&v2->env);
-                    env_configure(&v2->env, attack, decay, sustain, release);
+                    env_configure(&v2->env, attack, decay, sustain, release, inst->sample_rate);
                     env_gate_on(&v2->env);
                 }
             }
@@ -1133,7 +1741,7 @@ static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source)
         case 0xB0: { /* CC */
             if (data1 == 1) {
                 /* Mod wheel -> vibrato depth */
-                inst->params[P_VIBRATO_DEPTH] = (float)(int)(data2 * 12.0f / 127.0f);
+                inst->mod_vibrato_depth = (float)(int)(data2 * 12.0f / 127.0f);
             }
             if (data1 == 123 || data1 == 120) {
                 /* All notes off / All sound off */
@@ -1150,232 +1758,277 @@ static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source)
     }
 }
 
-static void v2_set_param(void *instance, const char *key, const char *val) {
+/* Set on the thread that calls render_block, so on_midi can tell it is
+ * being called from the audio thread (host feeding MIDI synchronously,
+ * inside or between render calls). */
+static thread_local int t_render_thread = 0;
+
+static int64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Sample offset for an event arriving now: time since the last render
+ * started, i.e. its position within the block that was playing. Events
+ * from the audio thread itself, or before the first render, go at 0: on
+ * the audio thread, the time since the last render started is how long
+ * that render took, not when the event arrived. */
+static uint32_t midi_arrival_offset(chiptune_instance_t *inst) {
+    int64_t start = inst->render_start_ns.load(std::memory_order_acquire);
+    if (t_render_thread || start == 0) return 0;
+    int64_t elapsed = monotonic_ns() - start;
+    if (elapsed <= 0) return 0;
+    int64_t offset = elapsed * inst->sample_rate / 1000000000LL;
+    if (offset > 0xFFFF) offset = 0xFFFF;  /* render clamps to the block */
+    return (uint32_t)offset;
+}
+
+static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source) {
     chiptune_instance_t *inst = (chiptune_instance_t*)instance;
-    if (!inst || !key || !val) return;
+    if (!inst || len < 2) return;
+    (void)source;
+
+    if (midi_queue_push(&inst->midi_queue, msg, len, midi_arrival_offset(inst)) != 0) {
+        inst->midi_dropped++;
+    }
+}
 
-    /* State restore */
-    if (strcmp(key, "state") == 0) {
+/* Apply a saved "state" object: the preset first, then the chip and any
+ * params it overrides. The string is scanned once and each member looked
+ * up by key; unknown and non-numeric members are ignored.
+ * Returns 0, or -1 (nothing applied) if the string is not a JSON object. */
+static int state_restore(chiptune_instance_t *inst, const char *json) {
+    json_member_t members[STATE_MAX_MEMBERS];
+    int count = json_scan_object(json, members, STATE_MAX_MEMBERS);
+    if (count < 0) return -1;
+
+    float values[P_COUNT];
+    uint8_t have[P_COUNT];
+    int preset = -1;
+    int chip = -1;
+    memset(have, 0, sizeof(have));
+
+    for (int i = 0; i < count; i++) {
         float fval;
-        /* Restore preset first */
-        if (json_get_number(val, "preset", &fval) == 0) {
-            int idx = (int)fval;
-            if (idx >= 0 && idx < NUM_PRESETS) {
-                kill_all_voices(inst);
-                apply_preset(inst, idx);
-            }
-        }
-        /* Then override with saved params */
-        if (json_get_number(val, "chip", &fval) == 0) {
-            inst->chip = (uint8_t)(int)fval;
-        }
-        for (int i = 0; i < (int)PARAM_DEF_COUNT(g_param_defs); i++) {
-            if (json_get_number(val, g_param_defs[i].key, &fval) == 0) {
-                if (fval < g_param_defs[i].min_val) fval = g_param_defs[i].min_val;
-                if (fval > g_param_defs[i].max_val) fval = g_param_defs[i].max_val;
-                inst->params[g_param_defs[i].index] = fval;
-            }
-        }
-        /* Reinit APUs after state restore */
-        init_nes_apu(inst);
-        init_gb_apu(inst);
-        if (inst->chip == CHIP_GB) {
-            gb_load_wavetable(inst, (int)inst->params[P_WAVETABLE], 0);
+        if (json_member_number(&members[i], &fval) != 0) continue;
+        int id = param_index_find_n(&g_key_index, members[i].key, members[i].key_len);
+        if (id >= 0 && id < P_COUNT) {
+            const param_def_t *def = &g_param_defs[id];
+            if (fval < def->min_val) fval = def->min_val;
+            if (fval > def->max_val) fval = def->max_val;
+            values[id] = fval;
+            have[id] = 1;
+        } else if (id == K_PRESET) {
+            if (fval >= 0 && fval < NUM_PRESETS) preset = (int)fval;
+        } else if (id == K_CHIP) {
+            if ((int)fval == CHIP_NES || (int)fval == CHIP_GB) chip = (int)fval;
         }
-        return;
     }
 
-    /* Preset selection */
-    if (strcmp(key, "preset") == 0) {
-        int idx = atoi(val);
-        if (idx >= 0 && idx < NUM_PRESETS && idx != inst->current_preset) {
-            kill_all_voices(inst);
-            apply_preset(inst, idx);
-            /* Reinit APUs on preset change */
-            init_nes_apu(inst);
-            init_gb_apu(inst);
-            if (inst->chip == CHIP_GB) {
-                gb_load_wavetable(inst, (int)inst->params[P_WAVETABLE], 0);
-            }
-        }
-        return;
+    if (preset >= 0) apply_preset(inst, preset);
+    if (chip >= 0) inst->ui.chip = (uint8_t)chip;
+    for (int i = 0; i < P_COUNT; i++) {
+        if (have[i]) inst->ui.params[i] = values[i];
     }
+    return 0;
+}
 
-    /* Chip selection */
-    if (strcmp(key, "chip") == 0) {
-        if (strcmp(val, "NES") == 0 || strcmp(val, "0") == 0) {
-            inst->chip = CHIP_NES;
-        } else if (strcmp(val, "GB") == 0 || strcmp(val, "1") == 0) {
-            inst->chip = CHIP_GB;
-            gb_load_wavetable(inst, (int)inst->params[P_WAVETABLE], 0);
-        }
-        kill_all_voices(inst);
-        return;
+static int state_bin_save(const chiptune_instance_t *inst, char *buf, int buf_len) {
+    uint8_t data[STATE_BIN_HEADER + 4 * P_COUNT];
+    memcpy(data, "CHPT", 4);
+    data[4] = STATE_BIN_VERSION;
+    data[5] = (uint8_t)inst->current_preset;
+    data[6] = inst->ui.chip;
+    data[7] = P_COUNT;
+    for (int i = 0; i < P_COUNT; i++) {
+        uint32_t bits;
+        memcpy(&bits, &inst->ui.params[i], 4);
+        uint8_t *d = &data[STATE_BIN_HEADER + 4 * i];
+        d[0] = (uint8_t)bits;
+        d[1] = (uint8_t)(bits >> 8);
+        d[2] = (uint8_t)(bits >> 16);
+        d[3] = (uint8_t)(bits >> 24);
     }
+    return base64_encode(data, (int)sizeof(data), buf, buf_len);
+}
 
-    /* Alloc mode */
-    if (strcmp(key, "alloc_mode") == 0) {
-        if (strcmp(val, "Auto") == 0 || strcmp(val, "0") == 0) {
-            inst->params[P_ALLOC_MODE] = ALLOC_AUTO;
-        } else if (strcmp(val, "Lead") == 0 || strcmp(val, "1") == 0) {
-            inst->params[P_ALLOC_MODE] = ALLOC_LEAD;
-        } else if (strcmp(val, "Locked") == 0 || strcmp(val, "2") == 0) {
-            inst->params[P_ALLOC_MODE] = ALLOC_LOCKED;
-        }
-        return;
+/* Restore a state_bin blob in one pass over its params. Unlike a JSON
+ * restore, voices keep playing and the APUs are not reset unless the
+ * chip changes, so switching between similar sets is seamless.
+ * Returns the OP_* bits to publish, or -1 (nothing applied) if invalid. */
+static int state_bin_restore(chiptune_instance_t *inst, const char *text) {
+    uint8_t data[STATE_BIN_MAX];
+    int len = base64_decode(text, data, (int)sizeof(data));
+    if (len < STATE_BIN_HEADER || memcmp(data, "CHPT", 4) != 0 ||
+        data[4] != STATE_BIN_VERSION || data[5] >= NUM_PRESETS ||
+        (data[6] != CHIP_NES && data[6] != CHIP_GB) ||
+        len != STATE_BIN_HEADER + 4 * data[7]) {
+        return -1;
     }
 
-    /* All notes off */
-    if (strcmp(key, "all_notes_off") == 0) {
-        kill_all_voices(inst);
-        return;
+    param_snapshot_t prev = inst->ui;
+    if (data[5] != inst->current_preset || data[7] < P_COUNT) apply_preset(inst, data[5]);
+    inst->ui.chip = data[6];
+    int count = data[7];
+    if (count > P_COUNT) count = P_COUNT;
+    for (int i = 0; i < count; i++) {
+        const uint8_t *d = &data[STATE_BIN_HEADER + 4 * i];
+        uint32_t bits = (uint32_t)d[0] | ((uint32_t)d[1] << 8) |
+                        ((uint32_t)d[2] << 16) | ((uint32_t)d[3] << 24);
+        float v;
+        memcpy(&v, &bits, 4);
+        const param_def_t *def = &g_param_defs[i];
+        if (!(v >= def->min_val)) v = def->min_val;  /* also catches NaN */
+        if (v > def->max_val) v = def->max_val;
+        inst->ui.params[i] = v;
     }
 
-    /* Wavetable change: reload wave RAM */
-    if (strcmp(key, "wavetable") == 0) {
-        int idx = atoi(val);
-        if (idx < 0) idx = 0;
-        if (idx >= NUM_WAVETABLES) idx = NUM_WAVETABLES - 1;
-        inst->params[P_WAVETABLE] = (float)idx;
-        if (inst->chip == CHIP_GB) {
-            gb_load_wavetable(inst, idx, 0);
+    int ops = 0;
+    if (inst->ui.chip != prev.chip) ops |= OP_KILL_VOICES | OP_LOAD_WAVETABLE;
+    if (inst->ui.params[P_WAVETABLE] != prev.params[P_WAVETABLE]) ops |= OP_LOAD_WAVETABLE;
+    return ops;
+}
+
+static void v2_set_param(void *instance, const char *key, const char *val) {
+    chiptune_instance_t *inst = (chiptune_instance_t*)instance;
+    if (!inst || !key || !val) return;
+
+    int id = param_index_find(&g_key_index, key);
+    switch (id) {
+        /* State restore */
+        case K_STATE:
+            if (state_restore(inst, val) == 0) {
+                /* Reset APUs after state restore */
+                params_publish(inst, OP_KILL_VOICES | OP_RESET_APUS | OP_LOAD_WAVETABLE);
+            }
+            return;
+
+        /* Binary state restore */
+        case K_STATE_BIN: {
+            int ops = state_bin_restore(inst, val);
+            if (ops >= 0) params_publish(inst, (uint32_t)ops);
+            return;
         }
-        return;
+
+        /* Preset selection */
+        case K_PRESET: {
+            int idx = atoi(val);
+            if (idx >= 0 && idx < NUM_PRESETS && idx != inst->current_preset) {
+                apply_preset(inst, idx);
+                /* Reset APUs on preset change */
+                params_publish(inst, OP_KILL_VOICES | OP_RESET_APUS | OP_LOAD_WAVETABLE);
+            }
+            return;
+        }
+
+        /* Chip selection */
+        case K_CHIP: {
+            if (strcmp(val, "NES") == 0 || strcmp(val, "0") == 0) {
+                inst->ui.chip = CHIP_NES;
+            } else if (strcmp(val, "GB") == 0 || strcmp(val, "1") == 0) {
+                inst->ui.chip = CHIP_GB;
+            }
+            params_publish(inst, OP_KILL_VOICES | OP_LOAD_WAVETABLE);
+            return;
+        }
+
+        /* All notes off */
+        case K_ALL_NOTES_OFF:
+            params_publish(inst, OP_KILL_VOICES);
+            return;
+
+        /* Wavetable change: reload wave RAM */
+        case P_WAVETABLE: {
+            int idx = atoi(val);
+            if (idx < 0) idx = 0;
+            if (idx >= NUM_WAVETABLES) idx = NUM_WAVETABLES - 1;
+            inst->ui.params[P_WAVETABLE] = (float)idx;
+            params_publish(inst, OP_LOAD_WAVETABLE);
+            return;
+        }
+
+        /* Channel mask: the DMC bit only plays with samples in the bank */
+        case P_CHANNEL_MASK:
+            param_helper_set_def(&g_param_defs[id], inst->ui.params, val);
+            if (((int)inst->ui.params[P_CHANNEL_MASK] & 0x10) &&
+                (!inst->dmc_bank || inst->dmc_bank->count == 0)) {
+                plugin_log("channel_mask: DMC bit set but no samples in dmc/, ignored");
+            }
+            params_publish(inst, 0);
+            return;
+
+        /* Generic param_helper set */
+        default:
+            if (id >= 0 && id < P_COUNT) {
+                param_helper_set_def(&g_param_defs[id], inst->ui.params, val);
+                params_publish(inst, 0);
+            }
+            return;
     }
+}
 
-    /* Generic param_helper set */
-    if (param_helper_set(g_param_defs, PARAM_DEF_COUNT(g_param_defs),
-                         inst->params, key, val) == 0) {
-        return;
+static int state_json(const chiptune_instance_t *inst, char *buf, int buf_len) {
+    int offset = snprintf(buf, buf_len, "{\"preset\":%d,\"chip\":%d",
+                          inst->current_preset, inst->ui.chip);
+    for (int i = 0; i < P_COUNT && offset < buf_len; i++) {
+        offset += snprintf(buf + offset, buf_len - offset,
+            ",\"%s\":%d", g_param_defs[i].key, (int)inst->ui.params[i]);
     }
+    if (offset < buf_len) offset += snprintf(buf + offset, buf_len - offset, "}");
+    if (offset >= buf_len) return -1;
+    return offset;
 }
 
 static int v2_get_param(void *instance, const char *key, char *buf, int buf_len) {
     chiptune_instance_t *inst = (chiptune_instance_t*)instance;
     if (!inst) return -1;
 
-    if (strcmp(key, "name") == 0) {
-        return snprintf(buf, buf_len, "Chiptune");
-    }
-    if (strcmp(key, "preset") == 0) {
-        return snprintf(buf, buf_len, "%d", inst->current_preset);
-    }
-    if (strcmp(key, "preset_count") == 0) {
-        return snprintf(buf, buf_len, "%d", NUM_PRESETS);
-    }
-    if (strcmp(key, "preset_name") == 0) {
-        return snprintf(buf, buf_len, "%s", inst->preset_name);
-    }
-    if (strcmp(key, "chip") == 0) {
-        return snprintf(buf, buf_len, "%s", inst->chip == CHIP_NES ? "NES" : "GB");
-    }
-    if (strcmp(key, "alloc_mode") == 0) {
-        int mode = (int)inst->params[P_ALLOC_MODE];
-        const char *names[] = {"Auto", "Lead", "Locked"};
-        if (mode < 0) mode = 0;
-        if (mode > 2) mode = 2;
-        return snprintf(buf, buf_len, "%s", names[mode]);
-    }
-    if (strcmp(key, "noise_mode") == 0) {
-        int mode = (int)inst->params[P_NOISE_MODE];
-        return snprintf(buf, buf_len, "%s", mode ? "Short" : "Long");
-    }
-
-    /* param_helper params */
-    int result = param_helper_get(g_param_defs, PARAM_DEF_COUNT(g_param_defs),
-                                  inst->params, key, buf, buf_len);
-    if (result >= 0) return result;
-
-    /* UI hierarchy */
-    if (strcmp(key, "ui_hierarchy") == 0) {
-        const char *hierarchy =
-            "{\"modes\":null,\"levels\":{"
-                "\"root\":{"
-                    "\"list_param\":\"preset\","
-                    "\"count_param\":\"preset_count\","
-                    "\"name_param\":\"preset_name\","
-                    "\"children\":\"main\","
-                    "\"knobs\":[\"env_attack\",\"env_decay\",\"env_sustain\",\"env_release\","
-                               "\"duty\",\"vibrato_depth\",\"vibrato_rate\",\"volume\"],"
-                    "\"params\":[]"
-                "},"
-                "\"main\":{"
-                    "\"label\":\"Parameters\","
-                    "\"children\":null,"
-                    "\"knobs\":[\"env_attack\",\"env_decay\",\"env_sustain\",\"env_release\","
-                               "\"duty\",\"vibrato_depth\",\"vibrato_rate\",\"volume\"],"
-                    "\"params\":["
-                        "{\"key\":\"chip\",\"label\":\"Chip\"},"
-                        "{\"key\":\"duty\",\"label\":\"Duty Cycle\"},"
-                        "{\"key\":\"env_attack\",\"label\":\"Attack\"},"
-                        "{\"key\":\"env_decay\",\"label\":\"Decay\"},"
-                        "{\"key\":\"env_sustain\",\"label\":\"Sustain\"},"
-                        "{\"key\":\"env_release\",\"label\":\"Release\"},"
-                        "{\"key\":\"sweep\",\"label\":\"Sweep\"},"
-                        "{\"key\":\"vibrato_depth\",\"label\":\"Vibrato Depth\"},"
-                        "{\"key\":\"vibrato_rate\",\"label\":\"Vibrato Rate\"},"
-                        "{\"key\":\"pitch_env_depth\",\"label\":\"PEnv Depth\"},"
-                        "{\"key\":\"pitch_env_speed\",\"label\":\"PEnv Speed\"},"
-                        "{\"key\":\"alloc_mode\",\"label\":\"Voice Mode\"},"
-                        "{\"key\":\"noise_mode\",\"label\":\"Noise Mode\"},"
-                        "{\"key\":\"wavetable\",\"label\":\"Wavetable (GB)\"},"
-                        "{\"key\":\"volume\",\"label\":\"Volume\"},"
-                        "{\"key\":\"octave_transpose\",\"label\":\"Octave\"}"
-                    "]"
-                "}"
-            "}}";
-        int len = strlen(hierarchy);
-        if (len < buf_len) {
-            strcpy(buf, hierarchy);
-            return len;
-        }
-        return -1;
-    }
+    int id = param_index_find(&g_key_index, key);
+    switch (id) {
+        case K_NAME:
+            return snprintf(buf, buf_len, "Chiptune");
+        case K_PRESET:
+            return snprintf(buf, buf_len, "%d", inst->current_preset);
+        case K_PRESET_COUNT:
+            return snprintf(buf, buf_len, "%d", NUM_PRESETS);
+        case K_PRESET_NAME:
+            return snprintf(buf, buf_len, "%s", inst->preset_name);
+        case K_UNDERRUN_BLOCKS:
+            return snprintf(buf, buf_len, "%u", inst->underrun_blocks);
+        case K_OVERRUN_BLOCKS:
+            return snprintf(buf, buf_len, "%u", inst->overrun_blocks);
+        case K_MIDI_DROPPED:
+            return snprintf(buf, buf_len, "%u", inst->midi_dropped);
+        case K_REG_WRITES_ISSUED:
+            return snprintf(buf, buf_len, "%lu", inst->reg_writes_issued);
+        case K_REG_WRITES_SUPPRESSED:
+            return snprintf(buf, buf_len, "%lu", inst->reg_writes_suppressed);
+        case K_CHIP:
+            return snprintf(buf, buf_len, "%s", inst->ui.chip == CHIP_NES ? "NES" : "GB");
+        /* Host metadata, generated at init */
+        case K_UI_HIERARCHY:
+            return param_helper_copy(g_ui_hierarchy_json, g_ui_hierarchy_len, buf, buf_len);
+        case K_CHAIN_PARAMS:
+            return param_helper_copy(g_chain_params_json, g_chain_params_len, buf, buf_len);
+
+        /* State serialization, cached until the next change */
+        case K_STATE:
+            if (inst->state_dirty) {
+                inst->state_len = state_json(inst, inst->state_json, STATE_JSON_MAX);
+                inst->state_dirty = 0;
+            }
+            return param_helper_copy(inst->state_json, inst->state_len, buf, buf_len);
+        case K_STATE_BIN:
+            return state_bin_save(inst, buf, buf_len);
 
-    /* Chain params metadata */
-    if (strcmp(key, "chain_params") == 0) {
-        int offset = 0;
-        offset += snprintf(buf + offset, buf_len - offset,
-            "["
-            "{\"key\":\"chip\",\"name\":\"Chip\",\"type\":\"enum\",\"options\":[\"NES\",\"GB\"]},"
-            "{\"key\":\"alloc_mode\",\"name\":\"Voice Mode\",\"type\":\"enum\",\"options\":[\"Auto\",\"Lead\",\"Locked\"]},"
-            "{\"key\":\"noise_mode\",\"name\":\"Noise Mode\",\"type\":\"enum\",\"options\":[\"Long\",\"Short\"]},"
-            "{\"key\":\"duty\",\"name\":\"Duty Cycle\",\"type\":\"int\",\"min\":0,\"max\":3,\"step\":1},"
-            "{\"key\":\"env_attack\",\"name\":\"Attack\",\"type\":\"int\",\"min\":0,\"max\":15,\"step\":1},"
-            "{\"key\":\"env_decay\",\"name\":\"Decay\",\"type\":\"int\",\"min\":0,\"max\":15,\"step\":1},"
-            "{\"key\":\"env_sustain\",\"name\":\"Sustain\",\"type\":\"int\",\"min\":0,\"max\":15,\"step\":1},"
-            "{\"key\":\"env_release\",\"name\":\"Release\",\"type\":\"int\",\"min\":0,\"max\":15,\"step\":1},"
-            "{\"key\":\"sweep\",\"name\":\"Sweep\",\"type\":\"int\",\"min\":0,\"max\":7,\"step\":1},"
-            "{\"key\":\"vibrato_depth\",\"name\":\"Vibrato Depth\",\"type\":\"int\",\"min\":0,\"max\":12,\"step\":1},"
-            "{\"key\":\"vibrato_rate\",\"name\":\"Vibrato Rate\",\"type\":\"int\",\"min\":0,\"max\":10,\"step\":1},"
-            "{\"key\":\"wavetable\",\"name\":\"Wavetable (GB)\",\"type\":\"int\",\"min\":0,\"max\":7,\"step\":1},"
-            "{\"key\":\"channel_mask\",\"name\":\"Channel Mask\",\"type\":\"int\",\"min\":0,\"max\":15,\"step\":1},"
-            "{\"key\":\"detune\",\"name\":\"Detune\",\"type\":\"int\",\"min\":0,\"max\":50,\"step\":1},"
-            "{\"key\":\"volume\",\"name\":\"Volume\",\"type\":\"int\",\"min\":0,\"max\":15,\"step\":1},"
-            "{\"key\":\"octave_transpose\",\"name\":\"Octave\",\"type\":\"int\",\"min\":-3,\"max\":3,\"step\":1},"
-            "{\"key\":\"pitch_env_depth\",\"name\":\"PEnv Depth\",\"type\":\"int\",\"min\":0,\"max\":24,\"step\":1},"
-            "{\"key\":\"pitch_env_speed\",\"name\":\"PEnv Speed\",\"type\":\"int\",\"min\":0,\"max\":15,\"step\":1}"
-            "]");
-        if (offset >= buf_len) return -1;
-        return offset;
-    }
-
-    /* State serialization */
-    if (strcmp(key, "state") == 0) {
-        int offset = 0;
-        offset += snprintf(buf + offset, buf_len - offset,
-            "{\"preset\":%d,\"chip\":%d", inst->current_preset, inst->chip);
-        for (int i = 0; i < (int)PARAM_DEF_COUNT(g_param_defs); i++) {
-            float val = inst->params[g_param_defs[i].index];
-            offset += snprintf(buf + offset, buf_len - offset,
-                ",\"%s\":%d", g_param_defs[i].key, (int)val);
-        }
-        offset += snprintf(buf + offset, buf_len - offset, "}");
-        if (offset >= buf_len) return -1;
-        return offset;
+        default:
+            /* param_helper params */
+            if (id >= 0 && id < P_COUNT) {
+                return param_helper_get_def(&g_param_defs[id], inst->ui.params, buf, buf_len);
+            }
+            return -1;
     }
-
-    return -1;
 }
 
 static int v2_get_error(void *instance, char *buf, int buf_len) {
@@ -1389,142 +2042,330 @@ static int v2_get_error(void *instance, char *buf, int buf_len) {
  * Render block
  * ===================================================================== */
 
-static void v2_render_block(void *instance, int16_t *out_interleaved_lr, int frames) {
-    chiptune_instance_t *inst = (chiptune_instance_t*)instance;
-    if (!inst) {
-        memset(out_interleaved_lr, 0, frames * 4);
-        return;
+/* Samples to advance a voice by for an update of the given kind. A voice
+ * started since the last tick is advanced by one sample, enough for an
+ * instant attack; the rest of the way to the next tick is skipped there. */
+static int voice_update_frames(chiptune_instance_t *inst, voice_t *v, int frames, int kind) {
+    if (kind == UPDATE_BLOCK) return frames;
+    if (!v->triggered) {
+        v->ctrl_ahead = (kind == UPDATE_NEW ? inst->ctrl_elapsed : 0) + 1;
+        return 1;
     }
+    int n = frames - v->ctrl_ahead;
+    v->ctrl_ahead = 0;
+    return n > 0 ? n : 0;
+}
 
-    memset(out_interleaved_lr, 0, frames * 4);
+/* Per-voice pitch for this update, advancing the pitch envelope */
+static int32_t voice_pitch(chiptune_instance_t *inst, voice_t *v, int32_t block_pitch,
+                           int32_t detune_pitch, int frames) {
+    /* Base pitch plus bend and vibrato */
+    int32_t pitch = pitch_from_note(v->note) + block_pitch;
+    /* Apply pitch envelope (e.g., kick drum pitch drop) */
+    if (v->pitch_env > 0.01f) {
+        pitch += pitch_from_semitones(v->pitch_env);
+        float penv_speed = inst->params[P_PITCH_ENV_SPEED];
+        if (penv_speed > 0.0f) {
+            float decay_per_sample = v->pitch_env / (penv_speed * (inst->sample_rate / 60.0f));
+            v->pitch_env -= decay_per_sample * frames;
+            if (v->pitch_env < 0.0f) v->pitch_env = 0.0f;
+        }
+    }
+    /* Apply detune for second pulse channel in duo mode */
+    if (v->channel_idx == 1) {
+        pitch += detune_pitch;
+    }
+    return pitch;
+}
+
+/* APU volume (0-15) from envelope level, preset volume and velocity */
+static int voice_apu_volume(float level, int preset_vol, int velocity) {
+    int vol = (int)(level * (float)preset_vol / 15.0f * 15.0f + 0.5f);
+    if (vol > 15) vol = 15;
+    if (vol < 0) vol = 0;
+    /* Scale by velocity */
+    vol = (vol * velocity) / 127;
+    if (vol > 15) vol = 15;
+    return vol;
+}
 
+/* Shared pitch offsets for an update: bend and vibrato. Advances the LFO,
+ * except when only new voices are triggered between ticks. */
+static int32_t update_pitch(chiptune_instance_t *inst, int frames, int kind) {
+    float vib_depth = inst->mod_vibrato_depth >= 0.0f ? inst->mod_vibrato_depth
+                                                       : inst->params[P_VIBRATO_DEPTH];
+    float vib_rate = inst->params[P_VIBRATO_RATE];
+    int32_t pitch = pitch_from_semitones(inst->pitch_bend_semitones);
+    if (vib_depth > 0.0f && vib_rate > 0.0f) {
+        int32_t vib_range = pitch_from_semitones(vib_depth / 100.0f); /* depth in cents */
+        pitch += (lfo_value(inst, (int)inst->params[P_VIBRATO_SHAPE]) * vib_range) >> 15;
+    }
+    /* Advance LFO for the next update */
+    if (kind != UPDATE_NEW) lfo_advance(inst, vib_rate, frames);
+    return pitch;
+}
+
+/* Update NES voices at APU time 'time' and return the next free time.
+ * 'frames' is the length of the coming segment for UPDATE_BLOCK (the
+ * envelope level at its end is written at its start: block-rate updates
+ * give chiptune-authentic staircase behavior, ~2.9ms steps) or the
+ * samples since the last tick for UPDATE_TICK. */
+static int nes_update_voices(chiptune_instance_t *inst, int nes_time, int frames, int kind) {
     int duty = (int)inst->params[P_DUTY];
     int noise_mode = (int)inst->params[P_NOISE_MODE];
-    int sweep = (int)inst->params[P_SWEEP];
-    float vib_depth = inst->params[P_VIBRATO_DEPTH];
-    float vib_rate = inst->params[P_VIBRATO_RATE];
     int preset_vol = (int)inst->params[P_VOLUME];
-    float detune_cents = inst->params[P_DETUNE];
-    int wavetable_idx = (int)inst->params[P_WAVETABLE];
-
-    /* Check if any voices are active */
-    int any_active = 0;
-    for (int i = 0; i < MAX_VOICES; i++) {
-        if (inst->voices[i].active) { any_active = 1; break; }
-    }
+    int32_t block_pitch = update_pitch(inst, frames, kind);
+    int32_t detune_pitch = pitch_from_semitones(inst->params[P_DETUNE] / 100.0f);
+
+    for (int vi = 0; vi < MAX_VOICES; vi++) {
+        voice_t *v = &inst->voices[vi];
+        if (!v->active) continue;
+        if (kind == UPDATE_NEW && v->triggered) continue;
+
+        int n = voice_update_frames(inst, v, frames, kind);
+        env_advance(&v->env, n);
+        float avg_level = env_level(&v->env);
+
+        /* If envelope finished, mark voice inactive */
+        if (v->env.stage == ENV_IDLE) {
+            v->active = 0;
+            /* Silence this channel */
+            nes_silence_channel(inst, v->channel_idx, nes_time);
+            nes_time += 2;
+            continue;
+        }
 
-    if (inst->chip == CHIP_NES) {
-        /* ---- NES rendering ---- */
-        int nes_time = 0;
+        int32_t pitch = voice_pitch(inst, v, block_pitch, detune_pitch, n);
+        int apu_vol = voice_apu_volume(avg_level, preset_vol, v->velocity);
 
-        /* Re-enable channels each frame */
-        inst->nes_apu.write_register(nes_time++, 0x4015, 0x0F);
+        /* Write to appropriate APU channel */
+        int do_trigger = !v->triggered;
+        switch (v->channel_type) {
+            case CHAN_PULSE1:
+                nes_write_pulse(inst, 0, nes_time, duty, apu_vol, pitch, do_trigger);
+                nes_time += 4;
+                break;
+            case CHAN_PULSE2:
+                nes_write_pulse(inst, 1, nes_time, duty, apu_vol, pitch, do_trigger);
+                nes_time += 4;
+                break;
+            case CHAN_TRIANGLE:
+                /* Triangle has no volume control, just gate */
+                nes_write_triangle(inst, nes_time, (apu_vol > 0) ? 1 : 0, pitch, do_trigger);
+                nes_time += 3;
+                break;
+            case CHAN_NOISE:
+                nes_write_noise(inst, nes_time, apu_vol, v->note, noise_mode, do_trigger);
+                nes_time += 3;
+                break;
+            case CHAN_DMC:
+                /* Started on trigger, cut when the voice ends */
+                if (do_trigger) {
+                    nes_write_dmc(inst, nes_time, v->note);
+                    nes_time += 6;
+                }
+                break;
+        }
+        v->triggered = 1;
+    }
+    if (kind == UPDATE_NEW) return nes_time;
 
+    /* Silence inactive channels */
+    for (int ch = 0; ch < 5; ch++) {
+        int in_use = 0;
         for (int vi = 0; vi < MAX_VOICES; vi++) {
-            voice_t *v = &inst->voices[vi];
-            if (!v->active) continue;
-
-            /* Advance envelope through the block, then sample the level.
-             * Block-rate updates give chiptune-authentic staircase behavior (~2.9ms steps). */
-            for (int s = 0; s < frames; s++) {
-                env_process(&v->env);
+            if (inst->voices[vi].active && inst->voices[vi].channel_idx == ch) {
+                in_use = 1;
+                break;
             }
-            float avg_level = v->env.level;
+        }
+        if (!in_use) {
+            nes_silence_channel(inst, ch, nes_time);
+            nes_time += 2;
+        }
+    }
+    return nes_time;
+}
 
-            /* If envelope finished, mark voice inactive */
-            if (v->env.stage == ENV_IDLE) {
-                v->active = 0;
-                /* Silence this channel */
-                nes_silence_channel(inst, v->channel_idx, nes_time);
-                nes_time += 2;
-                continue;
-            }
+/* GB counterpart of nes_update_voices */
+static unsigned gb_update_voices(chiptune_instance_t *inst, unsigned gb_time, int frames, int kind) {
+    int duty = (int)inst->params[P_DUTY];
+    int noise_mode = (int)inst->params[P_NOISE_MODE];
+    int sweep = (int)inst->params[P_SWEEP];
+    int preset_vol = (int)inst->params[P_VOLUME];
+    int32_t block_pitch = update_pitch(inst, frames, kind);
+    int32_t detune_pitch = pitch_from_semitones(inst->params[P_DETUNE] / 100.0f);
+
+    /* Envelope is applied via APU volume registers directly,
+     * same as the NES path. No output-level scaling needed. */
+    for (int vi = 0; vi < MAX_VOICES; vi++) {
+        voice_t *v = &inst->voices[vi];
+        if (!v->active) continue;
+        if (kind == UPDATE_NEW && v->triggered) continue;
+
+        int n = voice_update_frames(inst, v, frames, kind);
+        env_advance(&v->env, n);
+        float avg_level = env_level(&v->env);
+
+        /* If envelope finished, mark voice inactive */
+        if (v->env.stage == ENV_IDLE) {
+            v->active = 0;
+            gb_silence_channel(inst, v->channel_idx, gb_time);
+            gb_time += 4;
+            continue;
+        }
 
-            /* Compute vibrato */
-            float vib_mult = 1.0f;
-            if (vib_depth > 0.0f && vib_rate > 0.0f) {
-                float lfo_val = sinf(inst->lfo_phase * 2.0f * 3.14159265f);
-                vib_mult = powf(2.0f, lfo_val * vib_depth / 1200.0f);
-            }
+        int32_t pitch = voice_pitch(inst, v, block_pitch, detune_pitch, n);
+        int gb_vol = voice_apu_volume(avg_level, preset_vol, v->velocity);
+        /* Keep DAC enabled while voice is active (vol 0 disables DAC on some channels) */
+        if (gb_vol < 1) gb_vol = 1;
 
-            /* Base frequency */
-            float base_freq = midi_to_freq(v->note);
-            /* Apply pitch bend */
-            base_freq *= powf(2.0f, inst->pitch_bend_semitones / 12.0f);
-            /* Apply pitch envelope (e.g., kick drum pitch drop) */
-            if (v->pitch_env > 0.01f) {
-                base_freq *= powf(2.0f, v->pitch_env / 12.0f);
-                float penv_speed = inst->params[P_PITCH_ENV_SPEED];
-                if (penv_speed > 0.0f) {
-                    float decay_per_sample = v->pitch_env / (penv_speed * (SAMPLE_RATE / 60.0f));
-                    v->pitch_env -= decay_per_sample * frames;
-                    if (v->pitch_env < 0.0f) v->pitch_env = 0.0f;
-                }
-            }
-            /* Apply vibrato */
-            float freq = base_freq * vib_mult;
+        int do_trigger = !v->triggered;
+        switch (v->channel_idx) {
+            case 0:
+                gb_write_square1(inst, gb_time, duty, gb_vol, pitch, sweep, do_trigger);
+                gb_time += do_trigger ? 5 : 2;
+                break;
+            case 1:
+                gb_write_square2(inst, gb_time, duty, gb_vol, pitch, do_trigger);
+                gb_time += do_trigger ? 4 : 2;
+                break;
+            case 2: /* wave */
+                gb_write_wave(inst, gb_time, gb_vol, pitch, do_trigger);
+                gb_time += 4;
+                break;
+            case 3: /* noise */
+                gb_write_noise(inst, gb_time, gb_vol, v->note, noise_mode, do_trigger);
+                gb_time += do_trigger ? 4 : 2;
+                break;
+        }
+        v->triggered = 1;
+    }
+    if (kind == UPDATE_NEW) return gb_time;
 
-            /* Apply detune for second pulse channel in duo mode */
-            if (detune_cents > 0.0f && v->channel_idx == 1) {
-                freq *= powf(2.0f, detune_cents / 1200.0f);
+    /* Silence inactive channels */
+    for (int ch = 0; ch < 4; ch++) {
+        int in_use = 0;
+        for (int vi = 0; vi < MAX_VOICES; vi++) {
+            if (inst->voices[vi].active && inst->voices[vi].channel_idx == ch) {
+                in_use = 1;
+                break;
             }
+        }
+        if (!in_use) {
+            gb_silence_channel(inst, ch, gb_time);
+            gb_time += 4;
+        }
+    }
+    return gb_time;
+}
 
-            /* Compute APU volume from envelope */
-            int apu_vol = (int)(avg_level * (float)preset_vol / 15.0f * 15.0f + 0.5f);
-            if (apu_vol > 15) apu_vol = 15;
-            if (apu_vol < 0) apu_vol = 0;
-
-            /* Scale by velocity */
-            apu_vol = (apu_vol * v->velocity) / 127;
-            if (apu_vol > 15) apu_vol = 15;
-
-            /* Write to appropriate APU channel */
-            int do_trigger = !v->triggered;
-            switch (v->channel_type) {
-                case CHAN_PULSE1:
-                    nes_write_pulse(inst, 0, nes_time, duty, apu_vol, freq, do_trigger);
-                    nes_time += 4;
-                    break;
-                case CHAN_PULSE2:
-                    nes_write_pulse(inst, 1, nes_time, duty, apu_vol, freq, do_trigger);
-                    nes_time += 4;
-                    break;
-                case CHAN_TRIANGLE:
-                    /* Triangle has no volume control, just gate */
-                    nes_write_triangle(inst, nes_time, (apu_vol > 0) ? 1 : 0, freq, do_trigger);
-                    nes_time += 3;
-                    break;
-                case CHAN_NOISE:
-                    nes_write_noise(inst, nes_time, apu_vol, v->note, noise_mode, do_trigger);
-                    nes_time += 3;
-                    break;
-            }
-            v->triggered = 1;
+/* Apply queued MIDI events due at or before block offset 'pos'. Returns
+ * the offset of the next pending event, or -1 if none is left this block. */
+static int apply_midi_events(chiptune_instance_t *inst, int pos) {
+    const midi_event_t *ev;
+    while ((ev = midi_queue_peek(&inst->midi_queue, inst->midi_block_end)) != NULL) {
+        if ((int)ev->offset > pos) return (int)ev->offset;
+        handle_midi(inst, ev->data, ev->len);
+        midi_queue_pop(&inst->midi_queue);
+    }
+    return -1;
+}
+
+static int any_voice_untriggered(const chiptune_instance_t *inst) {
+    for (int i = 0; i < MAX_VOICES; i++) {
+        if (inst->voices[i].active && !inst->voices[i].triggered) return 1;
+    }
+    return 0;
+}
+
+/* Plan the segment starting at chunk position 'pos': apply the MIDI events
+ * due there and return the voice update to run at 'pos' (-1 for none),
+ * with its frame count in *update_frames and the segment end in *end.
+ * Segments end at the next MIDI event and, at sub-block control rates,
+ * at the next control tick. */
+static int plan_segment(chiptune_instance_t *inst, int base, int pos, int frames,
+                        int *end, int *update_frames) {
+    int next = apply_midi_events(inst, base + pos);
+    int seg_end = (next < 0 || next - base > frames) ? frames : next - base;
+
+    int rate = (int)inst->params[P_CONTROL_RATE];
+    if (rate != inst->ctrl_rate) ctrl_reset(inst, rate);
+    uint32_t period_q16 = ctrl_period_q16(inst, rate);
+
+    int kind;
+    if (period_q16 == 0) {
+        kind = UPDATE_BLOCK;
+        *update_frames = seg_end - pos;
+    } else {
+        if (inst->ctrl_countdown <= 0) {
+            kind = UPDATE_TICK;
+            *update_frames = inst->ctrl_elapsed;
+            ctrl_next_tick(inst, period_q16);
+        } else {
+            /* Between ticks only new notes are started */
+            kind = any_voice_untriggered(inst) ? UPDATE_NEW : -1;
+            *update_frames = 0;
         }
+        if (seg_end - pos > inst->ctrl_countdown) seg_end = pos + inst->ctrl_countdown;
+        inst->ctrl_countdown -= seg_end - pos;
+        inst->ctrl_elapsed += seg_end - pos;
+    }
+    *end = seg_end;
+    return kind;
+}
 
-        /* Silence inactive channels */
-        for (int ch = 0; ch < 4; ch++) {
-            int in_use = 0;
-            for (int vi = 0; vi < MAX_VOICES; vi++) {
-                if (inst->voices[vi].active && inst->voices[vi].channel_idx == ch) {
-                    in_use = 1;
-                    break;
+/* Render up to chunk_frames of audio into a zeroed output buffer. 'base' is
+ * the chunk's offset within the host block, for MIDI event timing. */
+static void render_chunk(chiptune_instance_t *inst, int16_t *out_interleaved_lr, int frames, int base) {
+    /* Idle fast path: channels were silenced and the output has decayed,
+     * so there is nothing to emulate until the next note-on. Register
+     * writes and end_frame are skipped; APU frame times are block-relative,
+     * so resuming later continues seamlessly. */
+    if (inst->quiescent) {
+        if (!any_voice_active(inst) &&
+            !midi_queue_peek(&inst->midi_queue, inst->midi_block_end)) return;
+        inst->quiescent = 0;
+        inst->settled_blocks = 0;
+    }
+
+    /* Peak raw Blip_Buffer sample this block, for the idle fast path */
+    int peak = 0;
+
+    /* Split the chunk into segments (see plan_segment) so each note and
+     * control tick lands on its own sample: a segment's voice update is
+     * written at the APU time of its first sample, count_clocks(pos).
+     * Updates are kept a sample short of the chunk end so their writes
+     * still fit in the frame. */
+    int pos = 0;
+    int last = frames > 1 ? frames - 2 : 0;
+
+    if (inst->chip == CHIP_NES) {
+        /* ---- NES rendering ---- */
+        int nes_time = 0;
+
+        /* Re-enable channels each frame, and the DMC while its sample
+         * plays: setting the bit again once it has ended would restart it */
+        if (inst->dmc_playing && !(inst->nes_apu.read_status(0) & 0x10)) inst->dmc_playing = 0;
+        nes_write(inst, nes_time++, 0x4015, inst->dmc_playing ? 0x1F : 0x0F);
+
+        while (pos < frames) {
+            int end, n;
+            int kind = plan_segment(inst, base, pos, frames, &end, &n);
+            if (kind >= 0) {
+                if (pos > 0) {
+                    int t = (int)inst->nes_blip.count_clocks(pos < last ? pos : last);
+                    if (t > nes_time) nes_time = t;
                 }
+                nes_time = nes_update_voices(inst, nes_time, n, kind);
             }
-            if (!in_use) {
-                nes_silence_channel(inst, ch, nes_time);
-                nes_time += 2;
-            }
-        }
-
-        /* Advance LFO */
-        if (vib_rate > 0.0f) {
-            inst->lfo_phase += vib_rate * (float)frames / (float)SAMPLE_RATE;
-            while (inst->lfo_phase >= 1.0f) inst->lfo_phase -= 1.0f;
+            pos = end;
         }
 
-        /* Run NES APU for the frame */
-        int total_cycles = NES_CYCLES_PER_BLOCK;
+        /* Run NES APU for the frame. The clock count comes from the
+         * Blip_Buffer so exactly 'frames' samples become available; a fixed
+         * rounded count would drift and slowly fill the (short) buffer. */
+        int total_cycles = (int)inst->nes_blip.count_clocks(frames);
         inst->nes_apu.end_frame(total_cycles);
         inst->nes_blip.end_frame(total_cycles);
 
@@ -1535,10 +2376,12 @@ static void v2_render_block(void *instance, int16_t *out_interleaved_lr, int fra
             memset(inst->nes_mono_buf, 0, sizeof(inst->nes_mono_buf));
             inst->nes_blip.read_samples(inst->nes_mono_buf, to_read);
 
-            /* Convert mono to stereo. NES APU output peaks ~5000; 6x scales to ~30000
-             * for good headroom within int16 range. */
+            /* Convert mono to stereo with the output gain */
             for (int s = 0; s < to_read; s++) {
-                int32_t sample = (int32_t)inst->nes_mono_buf[s] * 6;
+                int raw = inst->nes_mono_buf[s];
+                if (raw > peak) peak = raw;
+                if (-raw > peak) peak = -raw;
+                int32_t sample = (int32_t)raw * OUTPUT_GAIN;
                 if (sample > 32767) sample = 32767;
                 if (sample < -32768) sample = -32768;
                 out_interleaved_lr[s * 2] = (int16_t)sample;
@@ -1546,114 +2389,35 @@ static void v2_render_block(void *instance, int16_t *out_interleaved_lr, int fra
             }
         }
 
+        /* count_clocks() makes exactly 'frames' samples available; if that
+         * ever fails, count it, and drop any surplus so latency can't grow */
+        if (avail < frames) {
+            inst->underrun_blocks++;
+        } else if (avail > frames) {
+            inst->overrun_blocks++;
+            inst->nes_blip.remove_samples(avail - frames);
+        }
+
     } else {
         /* ---- GB rendering ---- */
         unsigned gb_time = 0;
 
-        /* Envelope is now applied via APU volume registers directly,
-         * same as the NES path. No output-level scaling needed. */
-
-        for (int vi = 0; vi < MAX_VOICES; vi++) {
-            voice_t *v = &inst->voices[vi];
-            if (!v->active) continue;
-
-            /* Advance envelope through block, then sample level */
-            for (int s = 0; s < frames; s++) {
-                env_process(&v->env);
-            }
-            float avg_level = v->env.level;
-
-            /* If envelope finished, mark voice inactive */
-            if (v->env.stage == ENV_IDLE) {
-                v->active = 0;
-                gb_silence_channel(inst, v->channel_idx, gb_time);
-                gb_time += 4;
-                continue;
-            }
-
-
-            /* Compute vibrato */
-            float vib_mult = 1.0f;
-            if (vib_depth > 0.0f && vib_rate > 0.0f) {
-                float lfo_val = sinf(inst->lfo_phase * 2.0f * 3.14159265f);
-                vib_mult = powf(2.0f, lfo_val * vib_depth / 1200.0f);
-            }
-
-            /* Base frequency */
-            float base_freq = midi_to_freq(v->note);
-            base_freq *= powf(2.0f, inst->pitch_bend_semitones / 12.0f);
-            /* Apply pitch envelope */
-            if (v->pitch_env > 0.01f) {
-                base_freq *= powf(2.0f, v->pitch_env / 12.0f);
-                float penv_speed = inst->params[P_PITCH_ENV_SPEED];
-                if (penv_speed > 0.0f) {
-                    float decay_per_sample = v->pitch_env / (penv_speed * (SAMPLE_RATE / 60.0f));
-                    v->pitch_env -= decay_per_sample * frames;
-                    if (v->pitch_env < 0.0f) v->pitch_env = 0.0f;
+        while (pos < frames) {
+            int end, n;
+            int kind = plan_segment(inst, base, pos, frames, &end, &n);
+            if (kind >= 0) {
+                if (pos > 0) {
+                    unsigned t = (unsigned)gb_apu_wrapper_count_clocks(inst->gb_apu, pos < last ? pos : last);
+                    if (t > gb_time) gb_time = t;
                 }
+                gb_time = gb_update_voices(inst, gb_time, n, kind);
             }
-            float freq = base_freq * vib_mult;
-
-            /* Detune for second square channel */
-            if (detune_cents > 0.0f && v->channel_idx == 1) {
-                freq *= powf(2.0f, detune_cents / 1200.0f);
-            }
-
-            /* Compute APU volume from envelope (same as NES path) */
-            int do_trigger = !v->triggered;
-            int gb_vol = (int)(avg_level * (float)preset_vol / 15.0f * 15.0f + 0.5f);
-            if (gb_vol > 15) gb_vol = 15;
-            if (gb_vol < 0) gb_vol = 0;
-            /* Scale by velocity */
-            gb_vol = (gb_vol * v->velocity) / 127;
-            if (gb_vol > 15) gb_vol = 15;
-            /* Keep DAC enabled while voice is active (vol 0 disables DAC on some channels) */
-            if (gb_vol < 1 && v->env.stage != ENV_IDLE) gb_vol = 1;
-
-            switch (v->channel_idx) {
-                case 0:
-                    gb_write_square1(inst, gb_time, duty, gb_vol, freq, sweep, do_trigger);
-                    gb_time += do_trigger ? 5 : 2;
-                    break;
-                case 1:
-                    gb_write_square2(inst, gb_time, duty, gb_vol, freq, do_trigger);
-                    gb_time += do_trigger ? 4 : 2;
-                    break;
-                case 2: /* wave */
-                    gb_write_wave(inst, gb_time, gb_vol, freq, do_trigger);
-                    gb_time += 4;
-                    break;
-                case 3: /* noise */
-                    gb_write_noise(inst, gb_time, gb_vol, v->note, noise_mode, do_trigger);
-                    gb_time += do_trigger ? 4 : 2;
-                    break;
-            }
-            v->triggered = 1;
+            pos = end;
         }
 
-        /* Silence inactive channels */
-        for (int ch = 0; ch < 4; ch++) {
-            int in_use = 0;
-            for (int vi = 0; vi < MAX_VOICES; vi++) {
-                if (inst->voices[vi].active && inst->voices[vi].channel_idx == ch) {
-                    in_use = 1;
-                    break;
-                }
-            }
-            if (!in_use) {
-                gb_silence_channel(inst, ch, gb_time);
-                gb_time += 4;
-            }
-        }
-
-        /* Advance LFO */
-        if (vib_rate > 0.0f) {
-            inst->lfo_phase += vib_rate * (float)frames / (float)SAMPLE_RATE;
-            while (inst->lfo_phase >= 1.0f) inst->lfo_phase -= 1.0f;
-        }
-
-        /* Run GB APU for this block — blargg handles frame sequencer internally */
-        long total_cycles = GB_CYCLES_PER_BLOCK;
+        /* Run GB APU for this block — blargg handles frame sequencer internally.
+         * Clock count comes from the Blip_Buffer, as for NES above. */
+        long total_cycles = gb_apu_wrapper_count_clocks(inst->gb_apu, frames);
         gb_apu_wrapper_end_frame(inst->gb_apu, total_cycles);
 
         /* Read stereo samples */
@@ -1662,22 +2426,64 @@ static void v2_render_block(void *instance, int16_t *out_interleaved_lr, int fra
         int stereo_shorts = frames * 2;
         if (avail < stereo_shorts) stereo_shorts = avail;
         if (stereo_shorts > 0) {
-            memset(inst->gb_stereo_buf, 0, sizeof(inst->gb_stereo_buf));
-            int read_count = gb_apu_wrapper_read_samples(inst->gb_apu, inst->gb_stereo_buf, stereo_shorts);
-
-            /* Copy to output with gain boost to match NES loudness */
-            int sample_pairs = read_count / 2;
-            for (int s = 0; s < sample_pairs && s < frames; s++) {
-                int32_t left = (int32_t)inst->gb_stereo_buf[s * 2] * 6;
-                int32_t right = (int32_t)inst->gb_stereo_buf[s * 2 + 1] * 6;
-                if (left > 32767) left = 32767;
-                if (left < -32768) left = -32768;
-                if (right > 32767) right = 32767;
-                if (right < -32768) right = -32768;
-                out_interleaved_lr[s * 2] = (int16_t)left;
-                out_interleaved_lr[s * 2 + 1] = (int16_t)right;
-            }
+            /* Mixed, scaled and saturated straight into the output in one pass */
+            gb_apu_wrapper_read_samples_gain(inst->gb_apu, out_interleaved_lr, stereo_shorts,
+                                             OUTPUT_GAIN, &peak);
+        }
+
+        /* Same readout check as NES, in shorts */
+        if (avail < frames * 2) {
+            inst->underrun_blocks++;
+        } else if (avail > frames * 2) {
+            inst->overrun_blocks++;
+            gb_apu_wrapper_remove_samples(inst->gb_apu, avail - frames * 2);
+        }
+    }
+
+    /* Enter the idle fast path once every voice has finished, the silence
+     * writes above have been emulated and the high-pass filtered output has
+     * stayed near zero long enough that stopping it is inaudible. */
+    if (!any_voice_active(inst) && peak <= QUIESCENT_LEVEL) {
+        if (++inst->settled_blocks >= QUIESCENT_BLOCKS) {
+            inst->quiescent = 1;
         }
+    } else {
+        inst->settled_blocks = 0;
+    }
+}
+
+static void v2_render_block(void *instance, int16_t *out_interleaved_lr, int frames) {
+    chiptune_instance_t *inst = (chiptune_instance_t*)instance;
+    if (frames <= 0) return;
+    memset(out_interleaved_lr, 0, frames * 4);
+    if (!inst) return;
+
+    /* Parameter changes and the operations they requested take effect at
+     * the block boundary, before this block's MIDI */
+    params_fetch(inst);
+
+    /* Take the MIDI events that arrived before this block; offsets of
+     * events arriving from now on are measured from this block's start */
+    t_render_thread = 1;
+    inst->midi_block_end = midi_queue_snapshot(&inst->midi_queue);
+    inst->render_start_ns.store(monotonic_ns(), std::memory_order_release);
+
+    /* Host blocks longer than the Blip_Buffers were sized for are rendered
+     * in several chunks, so the output is always completely filled. */
+    int base = 0;
+    while (frames > 0) {
+        int n = (frames < inst->chunk_frames) ? frames : inst->chunk_frames;
+        render_chunk(inst, out_interleaved_lr, n, base);
+        out_interleaved_lr += n * 2;
+        frames -= n;
+        base += n;
+    }
+
+    /* Anything still queued was stamped past the end of this block */
+    const midi_event_t *ev;
+    while ((ev = midi_queue_peek(&inst->midi_queue, inst->midi_block_end)) != NULL) {
+        handle_midi(inst, ev->data, ev->len);
+        midi_queue_pop(&inst->midi_queue);
     }
 }
 
@@ -1689,6 +2495,10 @@ static plugin_api_v2_t g_plugin_api_v2;
 
 extern "C" plugin_api_v2_t* move_plugin_init_v2(const host_api_v1_t *host) {
     g_host = host;
+    pitch_tables_init();
+    lfo_tables_init();
+    key_index_init();
+    meta_json_init();
 
     memset(&g_plugin_api_v2, 0, sizeof(g_plugin_api_v2));
     g_plugin_api_v2.api_version = MOVE_PLUGIN_API_VERSION_2;
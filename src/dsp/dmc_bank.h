@@ -0,0 +1,133 @@
+/*
+ * dmc_bank.h - NES DMC sample bank, memory-mapped and shared by instances
+ *
+ * The bank is every *.dmc file (raw 1-bit delta data, as played by the
+ * DMC channel) in <module_dir>/dmc/, in file name order, up to
+ * DMC_MAX_SAMPLES. Files are mapped read-only once per module directory
+ * and shared by all instances using it; the Nes_Apu DMC reader reads
+ * straight from the mapping.
+ *
+ * Usage (acquire/release lock and may allocate: control thread only):
+ *   dmc_bank_t *bank = dmc_bank_acquire(module_dir);   (count may be 0)
+ *   bank->samples[i].data, .len                        (read-only, any thread)
+ *   dmc_bank_release(bank);
+ */
+
+#ifndef DMC_BANK_H
+#define DMC_BANK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DMC_MAX_SAMPLES 16
+#define DMC_MAX_BYTES   (16 * 255 + 1)  /* longest sample $4013 can play */
+
+typedef struct {
+    const uint8_t *data;
+    int len;             /* bytes mapped, up to DMC_MAX_BYTES */
+    size_t map_len;      /* file size, for munmap */
+} dmc_sample_t;
+
+typedef struct dmc_bank {
+    char dir[256];
+    int refs;
+    int count;
+    dmc_sample_t samples[DMC_MAX_SAMPLES];
+    struct dmc_bank *next;
+} dmc_bank_t;
+
+static dmc_bank_t *g_dmc_banks = NULL;
+static pthread_mutex_t g_dmc_banks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int dmc_name_cmp(const void *a, const void *b) {
+    return strcmp((const char *)a, (const char *)b);
+}
+
+/* Map one sample file; returns 0 on success */
+static int dmc_map_file(const char *path, dmc_sample_t *s) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    s->data = (const uint8_t *)map;
+    s->map_len = (size_t)st.st_size;
+    s->len = st.st_size > DMC_MAX_BYTES ? DMC_MAX_BYTES : (int)st.st_size;
+    return 0;
+}
+
+static void dmc_bank_load(dmc_bank_t *bank) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/dmc", bank->dir);
+    DIR *d = opendir(path);
+    if (!d) return;
+
+    /* Names first, so the bank order doesn't depend on the file system */
+    char names[DMC_MAX_SAMPLES * 4][64];
+    int n = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL && n < DMC_MAX_SAMPLES * 4) {
+        size_t len = strlen(e->d_name);
+        if (len < 5 || len >= sizeof(names[0]) || strcmp(e->d_name + len - 4, ".dmc") != 0) continue;
+        memcpy(names[n++], e->d_name, len + 1);
+    }
+    closedir(d);
+    qsort(names, n, sizeof(names[0]), dmc_name_cmp);
+
+    for (int i = 0; i < n && bank->count < DMC_MAX_SAMPLES; i++) {
+        int len = snprintf(path, sizeof(path), "%s/dmc/%s", bank->dir, names[i]);
+        if (len < 0 || len >= (int)sizeof(path)) continue;  /* truncated path */
+        if (dmc_map_file(path, &bank->samples[bank->count]) == 0) bank->count++;
+    }
+}
+
+/* Bank for module_dir, loading it on first use; NULL only if out of memory */
+static dmc_bank_t *dmc_bank_acquire(const char *module_dir) {
+    pthread_mutex_lock(&g_dmc_banks_lock);
+    dmc_bank_t *bank;
+    for (bank = g_dmc_banks; bank; bank = bank->next) {
+        if (strcmp(bank->dir, module_dir) == 0) break;
+    }
+    if (!bank) {
+        bank = (dmc_bank_t *)calloc(1, sizeof(dmc_bank_t));
+        if (bank) {
+            snprintf(bank->dir, sizeof(bank->dir), "%s", module_dir);
+            dmc_bank_load(bank);
+            bank->next = g_dmc_banks;
+            g_dmc_banks = bank;
+        }
+    }
+    if (bank) bank->refs++;
+    pthread_mutex_unlock(&g_dmc_banks_lock);
+    return bank;
+}
+
+/* Drop a reference; the last one unmaps the samples */
+static void dmc_bank_release(dmc_bank_t *bank) {
+    if (!bank) return;
+    pthread_mutex_lock(&g_dmc_banks_lock);
+    if (--bank->refs == 0) {
+        dmc_bank_t **link = &g_dmc_banks;
+        while (*link != bank) link = &(*link)->next;
+        *link = bank->next;
+        for (int i = 0; i < bank->count; i++) {
+            munmap((void *)bank->samples[i].data, bank->samples[i].map_len);
+        }
+        free(bank);
+    }
+    pthread_mutex_unlock(&g_dmc_banks_lock);
+}
+
+#endif /* DMC_BANK_H */
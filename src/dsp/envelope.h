@@ -0,0 +1,181 @@
+/*
+ * envelope.h - Per-voice ADSR envelope
+ *
+ * Levels are Q24 fixed point (ENV_ONE = full level). Integer steps make
+ * env_advance(), which jumps a whole block in O(stages), give exactly the
+ * same level and stage as calling env_process() once per sample.
+ *
+ * Usage:
+ *   env_configure(&env, a, d, s, r, sample_rate);   (params 0-15)
+ *   env_gate_on(&env);  ...  env_gate_off(&env);
+ *   env_advance(&env, frames);  level = env_level(&env);
+ */
+
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include <stdint.h>
+
+/* Envelope stages (ADSR) */
+#define ENV_IDLE    0
+#define ENV_ATTACK  1
+#define ENV_DECAY   2
+#define ENV_SUSTAIN 3
+#define ENV_RELEASE 4
+
+#define ENV_FRAC_BITS 24
+#define ENV_ONE       (1 << ENV_FRAC_BITS)
+
+struct voice_envelope_t {
+    int32_t level;          /* Q24, 0..ENV_ONE */
+    int stage;              /* ENV_IDLE, ENV_ATTACK, ENV_DECAY, ENV_SUSTAIN, ENV_RELEASE */
+    int32_t attack_inc;     /* per-sample increment during attack */
+    int32_t decay_dec;      /* per-sample decrement during decay */
+    int32_t sustain_level;  /* Q24 sustain level */
+    int32_t release_dec;    /* per-sample decrement during release */
+};
+
+static inline void env_init(voice_envelope_t *env) {
+    env->level = 0;
+    env->stage = ENV_IDLE;
+    env->attack_inc = 0;
+    env->decay_dec = 0;
+    env->sustain_level = 0;
+    env->release_dec = 0;
+}
+
+/* Per-sample step that covers the full range in `samples` samples (>= 1) */
+static inline int32_t env_step_for(int samples) {
+    if (samples <= 1) return ENV_ONE; /* instant */
+    return (int32_t)(((int64_t)ENV_ONE + samples / 2) / samples);
+}
+
+static inline void env_configure(voice_envelope_t *env, int attack_param, int decay_param,
+                                 int sustain_param, int release_param, int sample_rate) {
+    /* Attack: param 0 = instant, 1-15 = progressively slower
+     * At param=0, instant attack (1 sample). At param=15, ~0.25 seconds. */
+    env->attack_inc = env_step_for(attack_param * sample_rate / 60);
+
+    /* Decay: param 0 = instant, 1-15 = progressively slower
+     * At param=0, instant. At param=15, ~1 second. */
+    env->decay_dec = env_step_for(decay_param * sample_rate / 15);
+
+    /* Sustain: 0 = no sustain (AD envelope), 15 = full level */
+    if (sustain_param < 0) sustain_param = 0;
+    if (sustain_param > 15) sustain_param = 15;
+    env->sustain_level = (int32_t)(((int64_t)ENV_ONE * sustain_param + 7) / 15);
+
+    /* Release: param 0 = instant, 1-15 = progressively slower
+     * At param=0, instant. At param=15, ~1 second. */
+    env->release_dec = env_step_for(release_param * sample_rate / 15);
+}
+
+static inline void env_gate_on(voice_envelope_t *env) {
+    env->stage = ENV_ATTACK;
+    /* Don't reset level - allows retriggering */
+}
+
+static inline void env_gate_off(voice_envelope_t *env) {
+    if (env->stage != ENV_IDLE) {
+        env->stage = ENV_RELEASE;
+    }
+}
+
+/* Current level as 0.0-1.0 */
+static inline float env_level(const voice_envelope_t *env) {
+    return (float)env->level * (1.0f / (float)ENV_ONE);
+}
+
+/* Advance envelope by one sample, return level (Q24) */
+static inline int32_t env_process(voice_envelope_t *env) {
+    switch (env->stage) {
+        case ENV_ATTACK:
+            env->level += env->attack_inc;
+            if (env->level >= ENV_ONE) {
+                env->level = ENV_ONE;
+                env->stage = ENV_DECAY;
+            }
+            break;
+        case ENV_DECAY:
+            env->level -= env->decay_dec;
+            if (env->level <= env->sustain_level) {
+                env->level = env->sustain_level;
+                if (env->sustain_level > 0) {
+                    env->stage = ENV_SUSTAIN;
+                } else {
+                    env->stage = ENV_IDLE; /* AD mode: no sustain */
+                }
+            }
+            break;
+        case ENV_SUSTAIN:
+            /* Hold at sustain level until gate off */
+            break;
+        case ENV_RELEASE:
+            env->level -= env->release_dec;
+            if (env->level <= 0) {
+                env->level = 0;
+                env->stage = ENV_IDLE;
+            }
+            break;
+        case ENV_IDLE:
+        default:
+            env->level = 0;
+            break;
+    }
+    return env->level;
+}
+
+/* Samples until a ramp of `step` per sample covers `distance`; the stage
+ * always ends on a sample, even when it starts at (or past) its target. */
+static inline int64_t env_steps_to(int64_t distance, int32_t step) {
+    if (distance <= 0) return 1;
+    return (distance + step - 1) / step;
+}
+
+/* Advance envelope by `frames` samples, identical to calling env_process()
+ * `frames` times. Returns level (Q24). */
+static inline int32_t env_advance(voice_envelope_t *env, int frames) {
+    int64_t left = frames;
+    while (left > 0) {
+        int64_t n;
+        switch (env->stage) {
+            case ENV_ATTACK:
+                n = env_steps_to((int64_t)ENV_ONE - env->level, env->attack_inc);
+                if (n > left) {
+                    env->level += (int32_t)(left * env->attack_inc);
+                    return env->level;
+                }
+                env->level = ENV_ONE;
+                env->stage = ENV_DECAY;
+                break;
+            case ENV_DECAY:
+                n = env_steps_to((int64_t)env->level - env->sustain_level, env->decay_dec);
+                if (n > left) {
+                    env->level -= (int32_t)(left * env->decay_dec);
+                    return env->level;
+                }
+                env->level = env->sustain_level;
+                env->stage = env->sustain_level > 0 ? ENV_SUSTAIN : ENV_IDLE;
+                break;
+            case ENV_RELEASE:
+                n = env_steps_to(env->level, env->release_dec);
+                if (n > left) {
+                    env->level -= (int32_t)(left * env->release_dec);
+                    return env->level;
+                }
+                env->level = 0;
+                env->stage = ENV_IDLE;
+                break;
+            case ENV_SUSTAIN:
+                return env->level;
+            case ENV_IDLE:
+            default:
+                env->level = 0;
+                return env->level;
+        }
+        left -= n;
+    }
+    return env->level;
+}
+
+#endif /* ENVELOPE_H */
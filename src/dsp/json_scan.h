@@ -0,0 +1,194 @@
+/*
+ * json_scan.h - Single-pass, allocation-free scanner for flat JSON objects
+ *
+ * Splits an object such as a saved "state" string into its members in one
+ * pass, without copying: each member points at its key and value inside
+ * the original string. Nested objects and arrays are validated and skipped
+ * as a whole, so a key is only ever matched against member names, never
+ * against text inside another member's value.
+ *
+ * Usage:
+ *   json_member_t m[32];
+ *   int n = json_scan_object(json, m, 32);      (-1 if malformed)
+ *   for (i = 0; i < n; i++)
+ *       if (json_member_is(&m[i], "volume") && json_member_number(&m[i], &v) == 0) ...
+ *
+ * Keys and string values are raw: escape sequences are not decoded.
+ */
+
+#ifndef JSON_SCAN_H
+#define JSON_SCAN_H
+
+#include <string.h>
+#include <stdlib.h>
+
+#define JSON_STRING 0
+#define JSON_NUMBER 1
+#define JSON_OTHER  2   /* true, false, null, object or array */
+
+#define JSON_MAX_DEPTH 16
+
+typedef struct {
+    const char *key;    /* not NUL-terminated */
+    int key_len;
+    const char *value;  /* for strings, the text between the quotes */
+    int value_len;
+    int type;           /* JSON_STRING, JSON_NUMBER, JSON_OTHER */
+} json_member_t;
+
+static inline const char *json_skip_ws(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+    return p;
+}
+
+/* p is just past an opening quote; returns the closing quote or NULL */
+static inline const char *json_scan_string(const char *p) {
+    while (*p != '"') {
+        if (*p == '\0' || (unsigned char)*p < 0x20) return NULL;
+        if (*p == '\\') {
+            p++;
+            if (*p == '\0') return NULL;
+        }
+        p++;
+    }
+    return p;
+}
+
+static inline const char *json_scan_digits(const char *p) {
+    if (*p < '0' || *p > '9') return NULL;
+    while (*p >= '0' && *p <= '9') p++;
+    return p;
+}
+
+/* Returns the end of the number starting at p, or NULL */
+static inline const char *json_scan_number(const char *p) {
+    if (*p == '-') p++;
+    if (*p == '0') {
+        p++;
+    } else if (!(p = json_scan_digits(p))) {
+        return NULL;
+    }
+    if (*p == '.' && !(p = json_scan_digits(p + 1))) return NULL;
+    if (*p == 'e' || *p == 'E') {
+        p++;
+        if (*p == '+' || *p == '-') p++;
+        if (!(p = json_scan_digits(p))) return NULL;
+    }
+    return p;
+}
+
+/* Returns the end of the object or array starting at p, or NULL. Only
+ * checks that brackets balance outside strings, which is enough to step
+ * over a value this scanner does not interpret. */
+static inline const char *json_skip_nested(const char *p) {
+    char stack[JSON_MAX_DEPTH];
+    int depth = 0;
+    do {
+        switch (*p) {
+            case '\0':
+                return NULL;
+            case '"':
+                if (!(p = json_scan_string(p + 1))) return NULL;
+                break;
+            case '{':
+            case '[':
+                if (depth == JSON_MAX_DEPTH) return NULL;
+                stack[depth++] = (*p == '{') ? '}' : ']';
+                break;
+            case '}':
+            case ']':
+                if (*p != stack[--depth]) return NULL;
+                break;
+        }
+        p++;
+    } while (depth > 0);
+    return p;
+}
+
+static inline const char *json_scan_literal(const char *p, const char *word) {
+    size_t n = strlen(word);
+    return strncmp(p, word, n) == 0 ? p + n : NULL;
+}
+
+/*
+ * Scan a JSON object into at most max_members members, in document order.
+ * Returns: the member count, or -1 if json is not a single well-formed
+ * object or has more than max_members members
+ */
+static inline int json_scan_object(const char *json, json_member_t *members, int max_members) {
+    const char *p = json_skip_ws(json);
+    if (*p++ != '{') return -1;
+    p = json_skip_ws(p);
+
+    int count = 0;
+    if (*p == '}') {
+        p++;
+    } else {
+        for (;;) {
+            if (count == max_members) return -1;
+            json_member_t *m = &members[count];
+
+            if (*p != '"') return -1;
+            m->key = p + 1;
+            if (!(p = json_scan_string(p + 1))) return -1;
+            m->key_len = (int)(p - m->key);
+            p = json_skip_ws(p + 1);
+            if (*p++ != ':') return -1;
+            p = json_skip_ws(p);
+
+            const char *end;
+            if (*p == '"') {
+                m->type = JSON_STRING;
+                m->value = p + 1;
+                if (!(end = json_scan_string(p + 1))) return -1;
+                m->value_len = (int)(end - m->value);
+                end++;
+            } else {
+                m->value = p;
+                if (*p == '-' || (*p >= '0' && *p <= '9')) {
+                    m->type = JSON_NUMBER;
+                    end = json_scan_number(p);
+                } else {
+                    m->type = JSON_OTHER;
+                    if (*p == '{' || *p == '[') end = json_skip_nested(p);
+                    else if (!(end = json_scan_literal(p, "true")) &&
+                             !(end = json_scan_literal(p, "false")))
+                        end = json_scan_literal(p, "null");
+                }
+                if (!end) return -1;
+                m->value_len = (int)(end - p);
+            }
+            count++;
+
+            p = json_skip_ws(end);
+            if (*p == ',') {
+                p = json_skip_ws(p + 1);
+            } else if (*p == '}') {
+                p++;
+                break;
+            } else {
+                return -1;
+            }
+        }
+    }
+
+    if (*json_skip_ws(p) != '\0') return -1;
+    return count;
+}
+
+static inline int json_member_is(const json_member_t *m, const char *key) {
+    return strncmp(m->key, key, m->key_len) == 0 && key[m->key_len] == '\0';
+}
+
+/*
+ * Value of a number member.
+ * Returns: 0 on success, -1 if the member is not a number
+ */
+static inline int json_member_number(const json_member_t *m, float *out) {
+    if (m->type != JSON_NUMBER) return -1;
+    /* The scanner checked the syntax, and the number ends at a delimiter */
+    *out = strtof(m->value, NULL);
+    return 0;
+}
+
+#endif /* JSON_SCAN_H */
@@ -0,0 +1,71 @@
+/*
+ * midi_queue.h - Lock-free MIDI event queue with sample offsets
+ *
+ * Single producer (the thread calling on_midi), single consumer (the render
+ * thread). Each event carries the sample offset within the block at which
+ * it should take effect.
+ *
+ * Usage:
+ *   producer: midi_queue_push(&q, msg, len, offset);
+ *   consumer: end = midi_queue_snapshot(&q);
+ *             while ((ev = midi_queue_peek(&q, end))) { ...; midi_queue_pop(&q); }
+ */
+
+#ifndef MIDI_QUEUE_H
+#define MIDI_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+#define MIDI_QUEUE_SIZE 256  /* power of two */
+
+typedef struct {
+    uint32_t offset;   /* sample offset within the block */
+    uint8_t len;
+    uint8_t data[3];
+} midi_event_t;
+
+typedef struct {
+    midi_event_t events[MIDI_QUEUE_SIZE];
+    std::atomic<uint32_t> head;  /* next event to read (consumer) */
+    std::atomic<uint32_t> tail;  /* next slot to write (producer) */
+} midi_queue_t;
+
+static inline void midi_queue_init(midi_queue_t *q) {
+    q->head.store(0, std::memory_order_relaxed);
+    q->tail.store(0, std::memory_order_relaxed);
+}
+
+/* Returns 0 on success, -1 if the queue is full (event dropped) */
+static inline int midi_queue_push(midi_queue_t *q, const uint8_t *msg, int len, uint32_t offset) {
+    uint32_t tail = q->tail.load(std::memory_order_relaxed);
+    if (tail - q->head.load(std::memory_order_acquire) >= MIDI_QUEUE_SIZE) return -1;
+
+    midi_event_t *ev = &q->events[tail & (MIDI_QUEUE_SIZE - 1)];
+    if (len > 3) len = 3;
+    ev->offset = offset;
+    ev->len = (uint8_t)len;
+    for (int i = 0; i < len; i++) ev->data[i] = msg[i];
+
+    q->tail.store(tail + 1, std::memory_order_release);
+    return 0;
+}
+
+/* Position just past the last event pushed so far; events pushed later are
+ * left for the next block */
+static inline uint32_t midi_queue_snapshot(midi_queue_t *q) {
+    return q->tail.load(std::memory_order_acquire);
+}
+
+/* Oldest event before 'end', or NULL */
+static inline const midi_event_t *midi_queue_peek(midi_queue_t *q, uint32_t end) {
+    uint32_t head = q->head.load(std::memory_order_relaxed);
+    if (head == end) return NULL;
+    return &q->events[head & (MIDI_QUEUE_SIZE - 1)];
+}
+
+static inline void midi_queue_pop(midi_queue_t *q) {
+    q->head.store(q->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+#endif /* MIDI_QUEUE_H */
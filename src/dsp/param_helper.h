@@ -8,6 +8,15 @@
  *   1. Define your params: static const param_def_t my_params[] = { ... };
  *   2. In get_param: return param_helper_get(my_params, COUNT, values, key, buf, len);
  *   3. In set_param: return param_helper_set(my_params, COUNT, values, key, val);
+ *
+ * For many keys or frequent polling, build a param_index_t once and resolve
+ * keys with param_index_find(), then use param_helper_get_def/set_def:
+ *   param_index_defs(&index, my_params, COUNT);       (at init)
+ *   int i = param_index_find(&index, key);            (O(1) on average)
+ *   if (i >= 0) return param_helper_get_def(&my_params[i], values, buf, len);
+ *
+ * Enum params list their option names in param_def_t.options; get returns
+ * the name and set accepts either the name or its number.
  */
 
 #ifndef PARAM_HELPER_H
@@ -16,6 +25,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 /* Parameter types */
 typedef enum {
@@ -31,8 +41,62 @@ typedef struct {
     int index;            /* Index into values array */
     float min_val;        /* Minimum value */
     float max_val;        /* Maximum value */
+    const char *const *options;  /* Enum: names for min_val..max_val, or NULL */
 } param_def_t;
 
+/* Option index for a value, clamped to the defined range */
+static inline int param_helper_option(const param_def_t *def, float value) {
+    int i = (int)value - (int)def->min_val;
+    int last = (int)def->max_val - (int)def->min_val;
+    if (i < 0) i = 0;
+    if (i > last) i = last;
+    return i;
+}
+
+/*
+ * Get the value of one parameter, already looked up.
+ * Returns: length written to buf
+ */
+static inline int param_helper_get_def(
+    const param_def_t *def,
+    const float *values,
+    char *buf,
+    int buf_len
+) {
+    if (def->options) {
+        return snprintf(buf, buf_len, "%s", def->options[param_helper_option(def, values[def->index])]);
+    } else if (def->type == PARAM_TYPE_INT) {
+        return snprintf(buf, buf_len, "%d", (int)values[def->index]);
+    } else {
+        return snprintf(buf, buf_len, "%.3f", values[def->index]);
+    }
+}
+
+/*
+ * Set the value of one parameter, already looked up.
+ */
+static inline void param_helper_set_def(
+    const param_def_t *def,
+    float *values,
+    const char *val
+) {
+    /* Enums accept an option name as well as a number */
+    if (def->options) {
+        int count = (int)def->max_val - (int)def->min_val + 1;
+        for (int i = 0; i < count; i++) {
+            if (strcmp(val, def->options[i]) == 0) {
+                values[def->index] = def->min_val + (float)i;
+                return;
+            }
+        }
+    }
+    float v = (float)atof(val);
+    /* Clamp to min/max */
+    if (v < def->min_val) v = def->min_val;
+    if (v > def->max_val) v = def->max_val;
+    values[def->index] = v;
+}
+
 /*
  * Get a parameter value by key.
  * Returns: length written to buf, or -1 if key not found
@@ -47,11 +111,7 @@ static inline int param_helper_get(
 ) {
     for (int i = 0; i < def_count; i++) {
         if (strcmp(key, defs[i].key) == 0) {
-            if (defs[i].type == PARAM_TYPE_INT) {
-                return snprintf(buf, buf_len, "%d", (int)values[defs[i].index]);
-            } else {
-                return snprintf(buf, buf_len, "%.3f", values[defs[i].index]);
-            }
+            return param_helper_get_def(&defs[i], values, buf, buf_len);
         }
     }
     return -1;  /* Key not found */
@@ -70,11 +130,7 @@ static inline int param_helper_set(
 ) {
     for (int i = 0; i < def_count; i++) {
         if (strcmp(key, defs[i].key) == 0) {
-            float v = (float)atof(val);
-            /* Clamp to min/max */
-            if (v < defs[i].min_val) v = defs[i].min_val;
-            if (v > defs[i].max_val) v = defs[i].max_val;
-            values[defs[i].index] = v;
+            param_helper_set_def(&defs[i], values, val);
             return 0;
         }
     }
@@ -82,7 +138,110 @@ static inline int param_helper_set(
 }
 
 /*
- * Generate chain_params JSON from parameter definitions.
+ * Key index: maps key strings to small integer ids with an open-addressing
+ * hash table (FNV-1a, linear probing). Keys are not copied, so they must
+ * outlive the index (string literals and param_def_t keys do).
+ */
+#ifndef PARAM_INDEX_SLOTS
+#define PARAM_INDEX_SLOTS 256  /* power of two; keep under half full */
+#endif
+
+typedef struct {
+    const char *keys[PARAM_INDEX_SLOTS];  /* NULL = empty slot */
+    uint32_t hashes[PARAM_INDEX_SLOTS];
+    int ids[PARAM_INDEX_SLOTS];
+    int count;
+} param_index_t;
+
+static inline uint32_t param_key_hash(const char *key) {
+    uint32_t h = 2166136261u;
+    while (*key) {
+        h ^= (uint8_t)*key++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline uint32_t param_key_hash_n(const char *key, int len) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h ^= (uint8_t)key[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline void param_index_init(param_index_t *index) {
+    memset(index, 0, sizeof(*index));
+}
+
+/*
+ * Add a key with its id.
+ * Returns: 0 on success, -1 if the key is already present or the index is full
+ */
+static inline int param_index_add(param_index_t *index, const char *key, int id) {
+    if (index->count >= PARAM_INDEX_SLOTS / 2) return -1;
+    uint32_t h = param_key_hash(key);
+    uint32_t slot = h & (PARAM_INDEX_SLOTS - 1);
+    while (index->keys[slot]) {
+        if (index->hashes[slot] == h && strcmp(index->keys[slot], key) == 0) return -1;
+        slot = (slot + 1) & (PARAM_INDEX_SLOTS - 1);
+    }
+    index->keys[slot] = key;
+    index->hashes[slot] = h;
+    index->ids[slot] = id;
+    index->count++;
+    return 0;
+}
+
+/*
+ * Look up a key.
+ * Returns: its id, or -1 if key not found
+ */
+static inline int param_index_find(const param_index_t *index, const char *key) {
+    uint32_t h = param_key_hash(key);
+    uint32_t slot = h & (PARAM_INDEX_SLOTS - 1);
+    while (index->keys[slot]) {
+        if (index->hashes[slot] == h && strcmp(index->keys[slot], key) == 0) {
+            return index->ids[slot];
+        }
+        slot = (slot + 1) & (PARAM_INDEX_SLOTS - 1);
+    }
+    return -1;
+}
+
+/*
+ * Look up a key given by pointer and length, e.g. one inside a JSON string.
+ * Returns: its id, or -1 if key not found
+ */
+static inline int param_index_find_n(const param_index_t *index, const char *key, int len) {
+    uint32_t h = param_key_hash_n(key, len);
+    uint32_t slot = h & (PARAM_INDEX_SLOTS - 1);
+    while (index->keys[slot]) {
+        if (index->hashes[slot] == h && strncmp(index->keys[slot], key, len) == 0 &&
+            index->keys[slot][len] == '\0') {
+            return index->ids[slot];
+        }
+        slot = (slot + 1) & (PARAM_INDEX_SLOTS - 1);
+    }
+    return -1;
+}
+
+/*
+ * Add every parameter definition, with its position in defs as the id.
+ * Returns: 0 on success, -1 on a duplicate key or a full index
+ */
+static inline int param_index_defs(param_index_t *index, const param_def_t *defs, int def_count) {
+    for (int i = 0; i < def_count; i++) {
+        if (param_index_add(index, defs[i].key, i) != 0) return -1;
+    }
+    return 0;
+}
+
+/*
+ * Generate chain_params JSON from parameter definitions. Enums are listed
+ * with their options, ints with a step of 1. The output only depends on
+ * the table, so generate it once and keep it.
  * Returns: length written to buf, or -1 if buffer too small
  */
 static inline int param_helper_chain_params_json(
@@ -94,23 +253,49 @@ static inline int param_helper_chain_params_json(
     int offset = 0;
     offset += snprintf(buf + offset, buf_len - offset, "[");
 
-    for (int i = 0; i < def_count && offset < buf_len - 100; i++) {
+    for (int i = 0; i < def_count && offset < buf_len; i++) {
+        const param_def_t *def = &defs[i];
         if (i > 0) offset += snprintf(buf + offset, buf_len - offset, ",");
         offset += snprintf(buf + offset, buf_len - offset,
-            "{\"key\":\"%s\",\"name\":\"%s\",\"type\":\"%s\",\"min\":%g,\"max\":%g}",
-            defs[i].key,
-            defs[i].name[0] ? defs[i].name : defs[i].key,
-            defs[i].type == PARAM_TYPE_INT ? "int" : "float",
-            defs[i].min_val,
-            defs[i].max_val);
+            "{\"key\":\"%s\",\"name\":\"%s\",",
+            def->key, def->name[0] ? def->name : def->key);
+        if (offset >= buf_len) break;
+        if (def->options) {
+            int count = (int)def->max_val - (int)def->min_val + 1;
+            offset += snprintf(buf + offset, buf_len - offset, "\"type\":\"enum\",\"options\":[");
+            for (int o = 0; o < count && offset < buf_len; o++) {
+                offset += snprintf(buf + offset, buf_len - offset, "%s\"%s\"",
+                                   o > 0 ? "," : "", def->options[o]);
+            }
+            if (offset >= buf_len) break;
+            offset += snprintf(buf + offset, buf_len - offset, "]}");
+        } else if (def->type == PARAM_TYPE_INT) {
+            offset += snprintf(buf + offset, buf_len - offset,
+                "\"type\":\"int\",\"min\":%g,\"max\":%g,\"step\":1}",
+                def->min_val, def->max_val);
+        } else {
+            offset += snprintf(buf + offset, buf_len - offset,
+                "\"type\":\"float\",\"min\":%g,\"max\":%g}",
+                def->min_val, def->max_val);
+        }
     }
 
-    offset += snprintf(buf + offset, buf_len - offset, "]");
+    if (offset < buf_len) offset += snprintf(buf + offset, buf_len - offset, "]");
 
     if (offset >= buf_len) return -1;
     return offset;
 }
 
+/*
+ * Copy a pre-generated string (JSON cached at init, say) into buf.
+ * Returns: len, or -1 if buffer too small
+ */
+static inline int param_helper_copy(const char *str, int len, char *buf, int buf_len) {
+    if (len < 0 || len >= buf_len) return -1;
+    memcpy(buf, str, len + 1);
+    return len;
+}
+
 /* Convenience macro for array count */
 #define PARAM_DEF_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
 
@@ -5,7 +5,9 @@
 
 #include <string.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <math.h>
+#include <pthread.h>
 
 /* Copyright (C) 2003-2005 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -125,20 +127,120 @@ blip_time_t Blip_Buffer::count_clocks( long count ) const
 	return ((count << BLIP_BUFFER_ACCURACY) - offset_ + (factor_ - 1)) / factor_;
 }
 
-void Blip_Impulse_::init( blip_pair_t_* imps, int w, int r, int fb )
+struct Blip_Impulse_::table_t {
+	table_t* next;
+	int refs;
+	int width;
+	int res;
+	int fine_bits;
+	blip_eq_t eq;
+	double volume_unit;
+	blip_pair_t_ pairs [1]; // actual size set when allocated
+};
+
+Blip_Impulse_::table_t* Blip_Impulse_::tables;
+static pthread_mutex_t impulse_tables_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Read until a volume is set, or if a table can't be allocated: with a zero
+// offset it adds nothing
+static const blip_pair_t_ silent_pairs [Blip_Buffer::widest_impulse_ << blip_res_bits_ << 1] = { 0 };
+
+void Blip_Impulse_::init( int w, int r, int fb )
 {
+	release( table );
+	table = NULL;
+	pairs = silent_pairs;
+	
 	fine_bits = fb;
 	width = w;
-	impulses = (imp_t*) imps;
-	generate = true;
+	impulses = NULL;
+	impulse = NULL;
+	eq_set = false;
+	volume_set = false;
 	volume_unit_ = -1.0;
 	res = r;
 	buf = NULL;
-	
-	impulse = &impulses [width * res * 2 * (fine_bits ? 2 : 1)];
 	offset = 0;
 }
 
+Blip_Impulse_::~Blip_Impulse_()
+{
+	release( table );
+}
+
+void Blip_Impulse_::release( table_t* t )
+{
+	if ( !t )
+		return;
+	
+	pthread_mutex_lock( &impulse_tables_lock );
+	if ( !--t->refs )
+	{
+		table_t** link = &tables;
+		while ( *link != t )
+			link = &(*link)->next;
+		*link = t->next;
+		free( t );
+	}
+	pthread_mutex_unlock( &impulse_tables_lock );
+}
+
+// Point at the shared table for the current parameters, generating it if no
+// other synth uses them
+void Blip_Impulse_::update()
+{
+	if ( !volume_set )
+		return;
+	
+	offset = 0x10001 * (unsigned long) floor( volume_unit_ * 0x10000 + 0.5 );
+	
+	pthread_mutex_lock( &impulse_tables_lock );
+	table_t* t = tables;
+	while ( t && !(t->width == width && t->res == res && t->fine_bits == fine_bits &&
+			t->eq.treble == eq.treble && t->eq.cutoff == eq.cutoff &&
+			t->eq.sample_rate == eq.sample_rate && t->volume_unit == volume_unit_) )
+		t = t->next;
+	
+	if ( !t )
+	{
+		// scaled impulses, then the unscaled one they are generated from
+		const long scaled_size = (long) width * res * 2 * (fine_bits ? 2 : 1);
+		const long size = scaled_size + width * (res / 2 + 1);
+		t = (table_t*) malloc( sizeof (table_t) + size * sizeof (imp_t) );
+		if ( t )
+		{
+			t->refs = 0;
+			t->width = width;
+			t->res = res;
+			t->fine_bits = fine_bits;
+			t->eq = eq;
+			t->volume_unit = volume_unit_;
+			
+			impulses = (imp_t*) t->pairs;
+			impulse = &impulses [scaled_size];
+			generate_impulse();
+			if ( fine_bits )
+				fine_volume_unit();
+			else
+				scale_impulse( offset & 0xffff, impulses );
+			impulses = NULL;
+			impulse = NULL;
+			
+			t->next = tables;
+			tables = t;
+		}
+	}
+	if ( t )
+		t->refs++;
+	pthread_mutex_unlock( &impulse_tables_lock );
+	
+	release( table );
+	table = t;
+	pairs = t ? t->pairs : silent_pairs;
+	if ( !t )
+		offset = 0;
+}
+
 const int impulse_bits = 15;
 const long impulse_amp = 1L << impulse_bits;
 const long impulse_offset = impulse_amp / 2;
@@ -210,33 +312,35 @@ void Blip_Impulse_::fine_volume_unit()
 
 void Blip_Impulse_::volume_unit( double new_unit )
 {
-	if ( new_unit == volume_unit_ )
+	if ( volume_set && new_unit == volume_unit_ )
 		return;
 	
-	if ( generate )
-		treble_eq( blip_eq_t( -8.87, 8800, 44100 ) );
+	if ( !eq_set )
+	{
+		eq = blip_eq_t( -8.87, 8800, 44100 );
+		eq_set = true;
+	}
 	
+	volume_set = true;
 	volume_unit_ = new_unit;
-	
-	offset = 0x10001 * (unsigned long) floor( volume_unit_ * 0x10000 + 0.5 );
-	
-	if ( fine_bits )
-		fine_volume_unit();
-	else
-		scale_impulse( offset & 0xffff, impulses );
+	update();
 }
 
 static const double pi = 3.1415926535897932384626433832795029L;
 
 void Blip_Impulse_::treble_eq( const blip_eq_t& new_eq )
 {
-	if ( !generate && new_eq.treble == eq.treble && new_eq.cutoff == eq.cutoff &&
+	if ( eq_set && new_eq.treble == eq.treble && new_eq.cutoff == eq.cutoff &&
 			new_eq.sample_rate == eq.sample_rate )
-		return; // already calculated with same parameters
+		return; // already using table with same parameters
 	
-	generate = false;
+	eq_set = true;
 	eq = new_eq;
-	
+	update();
+}
+
+void Blip_Impulse_::generate_impulse()
+{
 	double treble = pow( 10.0, 1.0 / 20 * eq.treble ); // dB (-6dB = 0.50)
 	if ( treble < 0.000005 )
 		treble = 0.000005;
@@ -324,14 +428,6 @@ void Blip_Impulse_::treble_eq( const blip_eq_t& new_eq )
 			*imp++ = (imp_t) floor( sum * factor + (impulse_offset + 0.5) );
 		}
 	}
-	
-	// rescale
-	double unit = volume_unit_;
-	if ( unit >= 0 )
-	{
-		volume_unit_ = -1;
-		volume_unit( unit );
-	}
 }
 
 void Blip_Buffer::remove_samples( long count )
@@ -184,25 +184,42 @@ const int blip_res_bits_ = 5;
 
 typedef BOOST::uint32_t blip_pair_t_;
 
+// Impulse tables depend only on the synth's shape, eq and volume unit, so
+// they are built once per process and shared read-only by every synth using
+// the same parameters.
 class Blip_Impulse_ {
 	typedef BOOST::uint16_t imp_t;
+	struct table_t;
+	static table_t* tables;
 	
 	blip_eq_t eq;
 	double  volume_unit_;
-	imp_t*  impulses;
+	table_t* table;
+	imp_t*  impulses; // table being generated
 	imp_t*  impulse;
 	int     width;
 	int     fine_bits;
 	int     res;
-	bool    generate;
+	bool    eq_set;
+	bool    volume_set;
 	
+	void update();
+	static void release( table_t* );
+	void generate_impulse();
 	void fine_volume_unit();
 	void scale_impulse( int unit, imp_t* ) const;
+	
+	// noncopyable
+	Blip_Impulse_( const Blip_Impulse_& );
+	Blip_Impulse_& operator = ( const Blip_Impulse_& );
 public:
 	Blip_Buffer*    buf;
 	BOOST::uint32_t offset;
+	const blip_pair_t_* pairs; // shared impulse table read by Blip_Synth
 	
-	void init( blip_pair_t_* impulses, int width, int res, int fine_bits = 0 );
+	Blip_Impulse_() : table( NULL ) { }
+	~Blip_Impulse_();
+	void init( int width, int res, int fine_bits = 0 );
 	void volume_unit( double );
 	void treble_eq( const blip_eq_t& );
 };
@@ -37,14 +37,12 @@ class Blip_Synth {
 		width = (quality < 5 ? quality * 4 : Blip_Buffer::widest_impulse_),
 		res = 1 << blip_res_bits_,
 		impulse_size = width / 2 * (fine_mode + 1),
-		base_impulses_size = width / 2 * (res / 2 + 1),
 		fine_bits = (fine_mode ? (abs_range <= 64 ? 2 : abs_range <= 128 ? 3 :
 			abs_range <= 256 ? 4 : abs_range <= 512 ? 5 : abs_range <= 1024 ? 6 :
 			abs_range <= 2048 ? 7 : 8) : 0)
 	};
-	blip_pair_t_  impulses [impulse_size * res * 2 + base_impulses_size];
 	Blip_Impulse_ impulse;
-	void init() { impulse.init( impulses, width, res, fine_bits ); }
+	void init() { impulse.init( width, res, fine_bits ); }
 public:
 	Blip_Synth()                            { init(); }
 	Blip_Synth( double volume )             { init(); this->volume( volume ); }
@@ -83,6 +81,10 @@ public:
 	void offset_inline( blip_time_t time, int delta ) const {
 		offset_inline( time, delta, impulse.buf );
 	}
+	
+	// Same as offset_resampled(), into memory laid out like a Blip_Buffer's
+	// samples (not documented)
+	void offset_to_( blip_resampled_time_t, int delta, Blip_Buffer::buf_t_* ) const;
 };
 
 // Blip_Wave is a synthesizer for adding a *single* waveform to a Blip_Buffer.
@@ -139,18 +141,25 @@ void Blip_Wave<quality,range>::amplitude( int amp ) {
 template<int quality,int range>
 inline void Blip_Synth<quality,range>::offset_resampled( blip_resampled_time_t time,
 		int delta, Blip_Buffer* blip_buf ) const
+{
+	assert(( "Blip_Synth/Blip_wave: Went past end of buffer",
+			((time >> BLIP_BUFFER_ACCURACY) & ~1) < blip_buf->buffer_size_ ));
+	offset_to_( time, delta, blip_buf->buffer_ );
+}
+
+template<int quality,int range>
+inline void Blip_Synth<quality,range>::offset_to_( blip_resampled_time_t time,
+		int delta, Blip_Buffer::buf_t_* samples ) const
 {
 	typedef blip_pair_t_ pair_t;
 	
 	unsigned sample_index = (time >> BLIP_BUFFER_ACCURACY) & ~1;
-	assert(( "Blip_Synth/Blip_wave: Went past end of buffer",
-			sample_index < blip_buf->buffer_size_ ));
 	enum { const_offset = Blip_Buffer::widest_impulse_ / 2 - width / 2 };
-	pair_t* buf = (pair_t*) &blip_buf->buffer_ [const_offset + sample_index];
+	pair_t* buf = (pair_t*) &samples [const_offset + sample_index];
 	
 	enum { shift = BLIP_BUFFER_ACCURACY - blip_res_bits_ };
 	enum { mask = res * 2 - 1 };
-	const pair_t* imp = &impulses [((time >> shift) & mask) * impulse_size];
+	const pair_t* imp = &impulse.pairs [((time >> shift) & mask) * impulse_size];
 	
 	pair_t offset = impulse.offset * delta;
 	
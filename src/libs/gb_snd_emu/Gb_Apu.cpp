@@ -31,6 +31,8 @@ Gb_Apu::Gb_Apu()
 	oscs [2] = &wave;
 	oscs [3] = &noise;
 	
+	wave.loop = &wave_loop;
+	
 	volume( 1.0 );
 	reset();
 }
@@ -43,6 +45,7 @@ void Gb_Apu::treble_eq( const blip_eq_t& eq )
 {
 	square_synth.treble_eq( eq );
 	other_synth.treble_eq( eq );
+	wave_loop.invalidate();
 }
 
 void Gb_Apu::volume( double vol )
@@ -50,6 +53,7 @@ void Gb_Apu::volume( double vol )
 	vol *= 0.60 / osc_count;
 	square_synth.volume( vol );
 	other_synth.volume( vol );
+	wave_loop.invalidate();
 }
 
 void Gb_Apu::output( Blip_Buffer* center, Blip_Buffer* left, Blip_Buffer* right )
@@ -69,6 +73,7 @@ void Gb_Apu::reset()
 	square2.reset();
 	wave.reset();
 	noise.reset();
+	wave_loop.invalidate();
 	
 	memset( regs, 0, sizeof regs );
 }
@@ -95,6 +100,19 @@ void Gb_Apu::osc_output( int index, Blip_Buffer* center, Blip_Buffer* left, Blip
 	osc.output = osc.outputs [osc.output_select];
 }
 
+// Called with each oscillator's own type, so run() is a direct call
+template<class Osc>
+inline void Gb_Apu::run_osc( Osc& osc, gb_time_t end_time )
+{
+	Blip_Buffer* const output = osc.output;
+	if ( output )
+	{
+		if ( output != osc.outputs [3] )
+			stereo_found = true;
+		osc.Osc::run( last_time, end_time );
+	}
+}
+
 void Gb_Apu::run_until( gb_time_t end_time )
 {
 	require( end_time >= last_time ); // end_time must not be before previous time
@@ -108,14 +126,10 @@ void Gb_Apu::run_until( gb_time_t end_time )
 			time = end_time;
 		
 		// run oscillators
-		for ( int i = 0; i < osc_count; ++i ) {
-			Gb_Osc& osc = *oscs [i];
-			if ( osc.output ) {
-				if ( osc.output != osc.outputs [3] )
-					stereo_found = true;
-				osc.run( last_time, time );
-			}
-		}
+		run_osc( square1, time );
+		run_osc( square2, time );
+		run_osc( wave, time );
+		run_osc( noise, time );
 		last_time = time;
 		
 		if ( time == end_time )
@@ -174,7 +188,14 @@ void Gb_Apu::write_register( gb_time_t time, gb_addr_t addr, int data )
 	{
 		// oscillator
 		int index = reg / 5;
-		oscs [index]->write_register( reg - index * 5, data ); 
+		reg -= index * 5;
+		switch ( index )
+		{
+		case 0: square1.Gb_Square::write_register( reg, data ); break;
+		case 1: square2.Gb_Square::write_register( reg, data ); break;
+		case 2: wave.Gb_Wave::write_register( reg, data ); break;
+		case 3: noise.Gb_Noise::write_register( reg, data ); break;
+		}
 	}
 	// added
 	else if ( addr == 0xff24 )
@@ -233,6 +254,7 @@ void Gb_Apu::write_register( gb_time_t time, gb_addr_t addr, int data )
 		int index = (addr & 0x0f) * 2;
 		wave.wave [index] = data >> 4;
 		wave.wave [index + 1] = data & 0x0f;
+		wave_loop.invalidate();
 	}
 }
 
@@ -69,11 +69,13 @@ private:
 	Gb_Square   square2;
 	Gb_Wave     wave;
 	Gb_Noise    noise;
+	Gb_Loop     wave_loop;
 	BOOST::uint8_t regs [register_count];
 	Gb_Square::Synth square_synth; // shared between squares
 	Gb_Wave::Synth   other_synth;  // shared between wave and noise
 	
 	void run_until( gb_time_t );
+	template<class Osc> void run_osc( Osc&, gb_time_t );
 };
 
 inline void Gb_Apu::output( Blip_Buffer* b ) { output( b, NULL, NULL ); }
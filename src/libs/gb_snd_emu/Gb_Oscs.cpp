@@ -58,6 +58,58 @@ void Gb_Osc::write_register( int reg, int value )
 		length_enabled = value & 0x40;
 }
 
+// Gb_Loop
+
+bool Gb_Loop::steady( Blip_Buffer* out, gb_time_t new_cycle, int new_amp, gb_time_t duration )
+{
+	if ( out != output || out->factor_ != factor || new_cycle != cycle || new_amp != amp )
+	{
+		output = out;
+		factor = out->factor_;
+		cycle = new_cycle;
+		amp = new_amp;
+		stable = 0;
+		filled = 0;
+		fits = (out->resampled_duration( cycle ) >> BLIP_BUFFER_ACCURACY) < max_span;
+		return false;
+	}
+	
+	if ( stable < steady_time )
+	{
+		stable += duration;
+		return false;
+	}
+	
+	return fits;
+}
+
+void Gb_Loop::add( Blip_Buffer* out, blip_resampled_time_t start, int key ) const
+{
+	buf_t_* buf = &out->buffer_ [start >> BLIP_BUFFER_ACCURACY];
+	const buf_t_* in = entries [key];
+	for ( int n = length [key]; n; --n )
+		*buf++ += *in++;
+}
+
+Gb_Loop::buf_t_* Gb_Loop::begin_capture( int key )
+{
+	buf_t_* entry = entries [key];
+	for ( int i = 0; i < entry_size; i++ )
+		entry [i] = Blip_Buffer::sample_offset_;
+	return entry;
+}
+
+void Gb_Loop::end_capture( int key, blip_resampled_time_t last )
+{
+	// impulses end within widest_impulse_ samples of the last transition
+	int n = ((last >> BLIP_BUFFER_ACCURACY) & ~1) + Blip_Buffer::widest_impulse_;
+	length [key] = n;
+	buf_t_* entry = entries [key];
+	for ( int i = 0; i < n; i++ )
+		entry [i] -= Blip_Buffer::sample_offset_;
+	filled |= BOOST::uint32_t (1) << key;
+}
+
 // Gb_Env
 
 void Gb_Env::reset()
@@ -260,6 +312,7 @@ void Gb_Wave::reset()
 }
 
 Gb_Wave::Gb_Wave() {
+	loop = NULL; // added
 }
 
 void Gb_Wave::write_register( int reg, int value )
@@ -330,6 +383,12 @@ void Gb_Wave::run( gb_time_t time, gb_time_t end_time )
 			int const volume_shift = this->volume_shift;
 		 	int wave_pos = this->wave_pos;
 		 	
+			// once steady, whole cycles starting before loop_end come from the loop cache
+			gb_time_t loop_end = time;
+			if ( loop && loop->steady( output, period * wave_size, vol_factor * 8 + volume_shift,
+					end_time - time ) )
+				loop_end = end_time - period * (wave_size - 1);
+			
 			do
 			{
 				wave_pos = unsigned (wave_pos + 1) % wave_size;
@@ -341,6 +400,8 @@ void Gb_Wave::run( gb_time_t time, gb_time_t end_time )
 					synth->offset_inline( time, delta, output );
 				}
 				time += period;
+				if ( wave_pos == wave_size - 1 && time < loop_end )
+					time = run_cycles( time, loop_end );
 			}
 			while ( time < end_time );
 			
@@ -351,6 +412,48 @@ void Gb_Wave::run( gb_time_t time, gb_time_t end_time )
 }
 
 
+// Whole cycles from the last wave position, while one starts before loop_end
+gb_time_t Gb_Wave::run_cycles( gb_time_t time, gb_time_t loop_end )
+{
+	const blip_resampled_time_t resampled_period = output->resampled_duration( period );
+	blip_resampled_time_t start = output->resampled_time( time );
+	int const vol_factor = global_volume * 2;
+	do
+	{
+		int const key = loop->key( start );
+		if ( loop->captured( key ) )
+		{
+			loop->add( output, start, key );
+		}
+		else
+		{
+			Gb_Loop::buf_t_* entry = loop->begin_capture( key );
+			blip_resampled_time_t const to_entry = loop->capture_time( key ) - start;
+			blip_resampled_time_t t = start;
+			blip_resampled_time_t last = t;
+			for ( int pos = 0; pos < wave_size; pos++ )
+			{
+				int amp = (wave [pos] >> volume_shift) * vol_factor;
+				int delta = amp - last_amp;
+				if ( delta )
+				{
+					last_amp = amp;
+					synth->offset_resampled( t, delta, output );
+					synth->offset_to_( t + to_entry, delta, entry );
+					last = t;
+				}
+				t += resampled_period;
+			}
+			loop->end_capture( key, last + to_entry );
+		}
+		time += period * wave_size;
+		start += resampled_period * wave_size;
+	}
+	while ( time < loop_end );
+	
+	return time;
+}
+
 // Gb_Noise
 
 void Gb_Noise::reset()
@@ -396,6 +499,110 @@ void Gb_Noise::write_register( int reg, int value )
 
 #include BLARGG_ENABLE_OPTIMIZER
 
+// At four or more LFSR steps per output sample (periods up to 16 clocks at
+// 44100 Hz), most band-limited steps cancel within a sample. Instead of one
+// impulse per transition, run_filtered() averages the same LFSR sequence over
+// each half sample and adds the average as one band-limited step, through the
+// same synth. That is the noise box-filtered and resampled at twice the output
+// rate, then band-limited as usual: level within 1 dB of the per-transition
+// loop below 17 kHz. The LFSR, amplitude and delay end up exactly as the
+// per-transition loop leaves them, so the two paths can take over from each
+// other at any time. Define GB_NOISE_FILTERED to 0 to always use the
+// per-transition loop.
+#ifndef GB_NOISE_FILTERED
+	#define GB_NOISE_FILTERED 1
+#endif
+
+enum { filtered_bin_bits = BLIP_BUFFER_ACCURACY - 1 };
+enum { filtered_bin_len = 1L << filtered_bin_bits };
+enum { filtered_max_period = filtered_bin_len / 2 };
+
+// Advances the LFSR by 'count' steps at once, 1 <= count <= tap. The next tap + 1
+// output bits are already in bits 0 to tap, so each new bit is the xor of two
+// known ones. Bits above tap only shift down until they reach tap and are
+// replaced, as in the one-step update.
+static inline unsigned advance_lfsr( unsigned bits, int tap, int count )
+{
+	unsigned const low_mask = (2u << tap) - 1;
+	unsigned const low = bits & low_mask;
+	unsigned const feedback = (low ^ (low >> 1)) & ((1u << count) - 1);
+	return ((bits >> count) & ~low_mask) | (low >> count) | (feedback << (tap + 1 - count));
+}
+
+gb_time_t Gb_Noise::run_filtered( gb_time_t time, gb_time_t end_time )
+{
+	Blip_Buffer* const output = this->output;
+	long const step_len = long (output->resampled_duration( period ));
+	
+	// Levels are kept relative to the current one, which earlier steps already
+	// hold in the buffer. Each bin's average is rounded to a synth unit and
+	// added at the bin's start; the last level is completed exactly after the
+	// last bin so nothing drifts.
+	int const level_on = volume * global_volume;
+	int const base = last_amp;
+	
+	long steps = (end_time - time + period - 1) / period;
+	blip_resampled_time_t step_time = output->resampled_time( time );
+	time += steps * period;
+	
+	blip_resampled_time_t bin_end = (step_time | (filtered_bin_len - 1)) + 1;
+	blip_resampled_time_t level_time = bin_end - filtered_bin_len;
+	
+	int const tap = this->tap;
+	unsigned bits = this->bits;
+	long const per_bin = filtered_bin_len / step_len; // at least 2
+	long count = (long (bin_end - step_time) + step_len - 1) / step_len;
+	int level = 0;
+	int written = 0;
+	
+	do
+	{
+		// level holds until step_time, then 'count' steps fall in this bin
+		long long sum = (long long) level * long (step_time - level_time);
+		if ( count > steps )
+			count = steps;
+		steps -= count;
+		
+		int ones = 0;
+		for ( long n = count; n; )
+		{
+			int chunk = (n < tap ? int (n) : tap);
+			ones += __builtin_popcount( (bits >> 1) & ((1u << chunk) - 1) );
+			bits = advance_lfsr( bits, tap, chunk );
+			n -= chunk;
+		}
+		
+		// each step's level for a full period, then the last cut off at bin_end
+		sum += (long long) ((count - 2 * ones) * level_on - count * base) * step_len;
+		level = (bits & 1 ? -level_on : level_on) - base;
+		step_time += count * step_len;
+		sum += (long long) level * (long (bin_end) - long (step_time));
+		
+		int average = int ((sum + filtered_bin_len / 2) >> filtered_bin_bits);
+		if ( average != written )
+		{
+			synth->offset_resampled( level_time, average - written, output );
+			written = average;
+		}
+		
+		level_time = bin_end;
+		bin_end += filtered_bin_len;
+		
+		// step_time is now within one period after level_time, so the next
+		// bin holds per_bin or per_bin + 1 steps
+		count = per_bin + (long (bin_end - step_time) > per_bin * step_len);
+	}
+	while ( steps );
+	
+	// level holds from here on
+	if ( level != written )
+		synth->offset_resampled( level_time, level - written, output );
+	
+	this->bits = bits;
+	last_amp = base + level;
+	return time;
+}
+
 void Gb_Noise::run( gb_time_t time, gb_time_t end_time )
 {
 	if ( !enabled || (!length && length_enabled) || !volume ) {
@@ -415,7 +622,12 @@ void Gb_Noise::run( gb_time_t time, gb_time_t end_time )
 		}
 		
 		time += delay;
-		if ( time < end_time )
+		if ( time < end_time && GB_NOISE_FILTERED &&
+				output->resampled_duration( period ) <= filtered_max_period )
+		{
+			time = run_filtered( time, end_time );
+		}
+		else if ( time < end_time )
 		{
 			Blip_Buffer* const output = this->output;
 			// keep parallel resampled time to eliminate multiplication in the loop
@@ -10,6 +10,58 @@
 
 enum { gb_apu_max_vol = 7 };
 
+// Loop cache for a wave channel held at a steady pitch (added). Once the
+// channel's period, volume and output have been unchanged for steady_time
+// clocks, each whole waveform cycle is captured the first time it starts at a
+// given phase within a sample (1/32 sample, as Blip_Synth uses), and later
+// cycles starting at the same phase add the captured samples instead of
+// synthesizing up to 32 transitions. Replayed cycles are placed to within
+// 1/64 sample of where the transitions would be, so output is close to but not
+// bit-identical with the per-transition loop. Call invalidate() when wave RAM
+// changes.
+struct Gb_Loop {
+	enum { max_span = 128 }; // longest cycle cached, in output samples
+	enum { steady_time = 4194304 / 64 };
+	enum { phase_shift = BLIP_BUFFER_ACCURACY - blip_res_bits_ };
+	enum { phase_count = 1 << blip_res_bits_ };
+	enum { entry_size = max_span + Blip_Buffer::widest_impulse_ };
+	typedef Blip_Buffer::buf_t_ buf_t_;
+	
+	// True if whole cycles can come from the cache. Call once per run with the
+	// oscillator's current state; any difference from the last call restarts
+	// the steady count and drops the captured cycles.
+	bool steady( Blip_Buffer*, gb_time_t cycle, int amp, gb_time_t duration );
+	
+	void invalidate() { output = NULL; }
+	
+	// Cache slot for a cycle starting at resampled time t. A cycle starting in
+	// the second sample of a pair adds the same samples one later.
+	int key( blip_resampled_time_t t ) const { return (t >> phase_shift) & (phase_count - 1); }
+	bool captured( int key ) const { return filled >> key & 1; }
+	void add( Blip_Buffer*, blip_resampled_time_t, int key ) const;
+	
+	// Capture a cycle: offset_to_( capture_time( key ) + t - start, delta, entry )
+	// for each transition at resampled time t, then end_capture() with the
+	// time of the last transition
+	buf_t_* begin_capture( int key );
+	blip_resampled_time_t capture_time( int key ) const {
+		return (blip_resampled_time_t (key) << phase_shift) + (1L << (phase_shift - 1));
+	}
+	void end_capture( int key, blip_resampled_time_t last );
+	
+	Gb_Loop() { invalidate(); }
+private:
+	Blip_Buffer* output;
+	unsigned long factor;
+	gb_time_t cycle;
+	int amp;
+	gb_time_t stable;
+	bool fits;
+	BOOST::uint32_t filled;
+	unsigned short length [phase_count];
+	buf_t_ entries [phase_count] [entry_size];
+};
+
 struct Gb_Osc {
 	Blip_Buffer* outputs [4]; // NULL, right, left, center
 	Blip_Buffer* output;
@@ -77,10 +129,14 @@ struct Gb_Wave : Gb_Osc {
 	typedef Blip_Synth<blip_med_quality,15 * gb_apu_max_vol * 2> Synth;
 	const Synth* synth;
 	
+	Gb_Loop* loop; // NULL if cycles aren't cached
+	
 	Gb_Wave();
 	void reset();
 	void run( gb_time_t, gb_time_t );
 	void write_register( int, int );
+private:
+	gb_time_t run_cycles( gb_time_t, gb_time_t );
 };
 
 struct Gb_Noise : Gb_Env {
@@ -94,6 +150,8 @@ struct Gb_Noise : Gb_Env {
 	void reset();
 	void run( gb_time_t, gb_time_t );
 	void write_register( int, int );
+private:
+	gb_time_t run_filtered( gb_time_t, gb_time_t );
 };
 
 #endif
@@ -100,11 +100,16 @@ void Stereo_Buffer::bass_freq( int bass )
 }
 
 void Stereo_Buffer::clear()
+{
+	clear( true );
+}
+
+void Stereo_Buffer::clear( bool entire_buffer )
 {
 	stereo_added = false;
 	was_stereo = false;
 	for ( int i = 0; i < buf_count; i++ )
-		bufs [i].clear();
+		bufs [i].clear( entire_buffer );
 }
 
 void Stereo_Buffer::end_frame( blip_time_t clock_count, bool stereo )
@@ -125,34 +130,60 @@ long Stereo_Buffer::read_samples( blip_sample_t* out, long count )
 		count = avail;
 	if ( count )
 	{
-		if ( stereo_added || was_stereo )
-		{
+		bool stereo = stereo_added || was_stereo;
+		if ( stereo )
 			mix_stereo( out, count );
-			
-			bufs [0].remove_samples( count );
-			bufs [1].remove_samples( count );
-			bufs [2].remove_samples( count );
-		}
 		else
-		{
 			mix_mono( out, count );
-			
-			bufs [0].remove_samples( count );
-			
-			bufs [1].remove_silence( count );
-			bufs [2].remove_silence( count );
-		}
-		
-		// to do: this might miss opportunities for optimization
-		if ( !bufs [0].samples_avail() ) {
-			was_stereo = stereo_added;
-			stereo_added = false;
-		}
+		remove_read( count, stereo );
+	}
+	
+	return count * 2;
+}
+
+long Stereo_Buffer::read_samples( blip_sample_t* out, long count, int gain, int* peak )
+{
+	require( !(count & 1) ); // count must be even
+	require( 1 <= gain && gain <= 0x7FFF );
+	count = (unsigned) count / 2;
+	
+	long avail = bufs [0].samples_avail();
+	if ( count > avail )
+		count = avail;
+	if ( count )
+	{
+		bool stereo = stereo_added || was_stereo;
+		if ( stereo )
+			mix_stereo( out, count, gain, peak );
+		else
+			mix_mono( out, count, gain, peak );
+		remove_read( count, stereo );
 	}
 	
 	return count * 2;
 }
 
+void Stereo_Buffer::remove_read( long count, bool stereo )
+{
+	bufs [0].remove_samples( count );
+	if ( stereo )
+	{
+		bufs [1].remove_samples( count );
+		bufs [2].remove_samples( count );
+	}
+	else
+	{
+		bufs [1].remove_silence( count );
+		bufs [2].remove_silence( count );
+	}
+	
+	// to do: this might miss opportunities for optimization
+	if ( !bufs [0].samples_avail() ) {
+		was_stereo = stereo_added;
+		stereo_added = false;
+	}
+}
+
 #include BLARGG_ENABLE_OPTIMIZER
 
 void Stereo_Buffer::mix_stereo( blip_sample_t* out, long count )
@@ -213,3 +244,221 @@ void Stereo_Buffer::mix_mono( blip_sample_t* out, long count )
 	in.end( bufs [0] );
 }
 
+// Gain readout. The Blip_Readers are serial (each sample's high-pass depends
+// on the previous one), so mixed samples are collected in groups of
+// gain_block and then clamped, scaled and interleaved together, with NEON
+// where available. The result is identical to read_samples() followed by
+// scaling each sample with saturation.
+
+#ifndef BLIP_USE_NEON
+	#if defined (__ARM_NEON) || defined (__ARM_NEON__)
+		#define BLIP_USE_NEON 1
+	#else
+		#define BLIP_USE_NEON 0
+	#endif
+#endif
+
+#include <stdint.h>
+#if BLIP_USE_NEON
+	#include <arm_neon.h>
+#endif
+
+enum { gain_block = 8 };
+
+// Clamp a mixed sample the way mix_stereo() does, including the wrap of
+// 0x8000 to -0x8000 when it is stored as a blip_sample_t
+static inline long clamp_mixed( long s )
+{
+	if ( (BOOST::int16_t) s != s )
+		s = (BOOST::int16_t) (0x7FFF - (s >> 24));
+	return s;
+}
+
+// Tracks the most negative and positive samples read
+struct gain_peak_t {
+	int lo;
+	int hi;
+	
+	void add( long s )
+	{
+		if ( s < lo ) lo = (int) s;
+		if ( s > hi ) hi = (int) s;
+	}
+	
+	void end( int* peak ) const
+	{
+		int p = hi > -lo ? hi : -lo;
+		if ( peak && p > *peak )
+			*peak = p;
+	}
+};
+
+static inline blip_sample_t apply_gain( long s, int gain )
+{
+	s *= gain;
+	if ( s > 0x7FFF ) s = 0x7FFF;
+	if ( s < -0x8000 ) s = -0x8000;
+	return (blip_sample_t) s;
+}
+
+static inline void scale_pair( blip_sample_t* out, long l, long r, int gain, gain_peak_t& peak )
+{
+	l = clamp_mixed( l );
+	r = clamp_mixed( r );
+	peak.add( l );
+	peak.add( r );
+	out [0] = apply_gain( l, gain );
+	out [1] = apply_gain( r, gain );
+}
+
+#if BLIP_USE_NEON
+
+// Vector form of scale_pair() for gain_block frames. Saturating narrowing
+// matches clamp_mixed() for the sample range a Blip_Reader can produce.
+struct gain_block_t {
+	int16x8_t lo;
+	int16x8_t hi;
+	int16x4_t gain;
+	
+	void begin( int g )
+	{
+		lo = vdupq_n_s16( 0 );
+		hi = vdupq_n_s16( 0 );
+		gain = vdup_n_s16( (int16_t) g );
+	}
+	
+	int16x8_t scale( int16x8_t s ) const
+	{
+		int16x4_t a = vqmovn_s32( vmull_s16( vget_low_s16( s ), gain ) );
+		int16x4_t b = vqmovn_s32( vmull_s16( vget_high_s16( s ), gain ) );
+		return vcombine_s16( a, b );
+	}
+	
+	void run( blip_sample_t* out, const int32_t* l, const int32_t* r, gain_peak_t& )
+	{
+		int16x8_t sl = vcombine_s16( vqmovn_s32( vld1q_s32( l ) ), vqmovn_s32( vld1q_s32( l + 4 ) ) );
+		int16x8_t sr = vcombine_s16( vqmovn_s32( vld1q_s32( r ) ), vqmovn_s32( vld1q_s32( r + 4 ) ) );
+		lo = vminq_s16( lo, vminq_s16( sl, sr ) );
+		hi = vmaxq_s16( hi, vmaxq_s16( sl, sr ) );
+		int16x8x2_t o;
+		o.val [0] = scale( sl );
+		o.val [1] = scale( sr );
+		vst2q_s16( out, o );
+	}
+	
+	void end( gain_peak_t& peak ) const
+	{
+		int16_t l [8], h [8];
+		vst1q_s16( l, lo );
+		vst1q_s16( h, hi );
+		for ( int i = 0; i < 8; i++ )
+		{
+			peak.add( l [i] );
+			peak.add( h [i] );
+		}
+	}
+};
+
+#else
+
+struct gain_block_t {
+	int gain;
+	
+	void begin( int g ) { gain = g; }
+	
+	void run( blip_sample_t* out, const int32_t* l, const int32_t* r, gain_peak_t& peak ) const
+	{
+		for ( int i = 0; i < gain_block; i++ )
+			scale_pair( out + i * 2, l [i], r [i], gain, peak );
+	}
+	
+	void end( gain_peak_t& ) const { }
+};
+
+#endif
+
+void Stereo_Buffer::mix_stereo( blip_sample_t* out, long count, int gain, int* peak_out )
+{
+	Blip_Reader left;
+	Blip_Reader right;
+	Blip_Reader center;
+	
+	left.begin( bufs [1] );
+	right.begin( bufs [2] );
+	int bass = center.begin( bufs [0] );
+	
+	gain_peak_t peak = { 0, 0 };
+	gain_block_t block;
+	block.begin( gain );
+	
+	for ( ; count >= gain_block; count -= gain_block )
+	{
+		int32_t l [gain_block];
+		int32_t r [gain_block];
+		for ( int i = 0; i < gain_block; i++ )
+		{
+			int c = center.read();
+			l [i] = c + left.read();
+			r [i] = c + right.read();
+			center.next( bass );
+			left.next( bass );
+			right.next( bass );
+		}
+		block.run( out, l, r, peak );
+		out += gain_block * 2;
+	}
+	
+	while ( count-- )
+	{
+		int c = center.read();
+		long l = c + left.read();
+		long r = c + right.read();
+		center.next( bass );
+		left.next( bass );
+		right.next( bass );
+		scale_pair( out, l, r, gain, peak );
+		out += 2;
+	}
+	
+	block.end( peak );
+	peak.end( peak_out );
+	
+	center.end( bufs [0] );
+	right.end( bufs [2] );
+	left.end( bufs [1] );
+}
+
+void Stereo_Buffer::mix_mono( blip_sample_t* out, long count, int gain, int* peak_out )
+{
+	Blip_Reader in;
+	int bass = in.begin( bufs [0] );
+	
+	gain_peak_t peak = { 0, 0 };
+	gain_block_t block;
+	block.begin( gain );
+	
+	for ( ; count >= gain_block; count -= gain_block )
+	{
+		int32_t s [gain_block];
+		for ( int i = 0; i < gain_block; i++ )
+		{
+			s [i] = in.read();
+			in.next( bass );
+		}
+		block.run( out, s, s, peak );
+		out += gain_block * 2;
+	}
+	
+	while ( count-- )
+	{
+		long s = in.read();
+		in.next( bass );
+		scale_pair( out, s, s, gain, peak );
+		out += 2;
+	}
+	
+	block.end( peak );
+	peak.end( peak_out );
+	
+	in.end( bufs [0] );
+}
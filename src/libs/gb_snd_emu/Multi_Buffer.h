@@ -105,9 +105,18 @@ public:
 	channel_t channel( int index );
 	void end_frame( blip_time_t, bool added_stereo = true );
 	
+	// See Blip_Buffer::clear(). Passing false only clears samples waiting to
+	// be read, which avoids touching the whole buffer on a reset.
+	void clear( bool entire_buffer );
+	
 	long samples_avail() const;
 	long read_samples( blip_sample_t*, long );
 	
+	// Same as read_samples(), but multiplies each sample by 'gain' (1 to
+	// 32767) with saturation in the same pass. If 'peak' isn't NULL, it is
+	// raised to the largest magnitude read before the gain was applied.
+	long read_samples( blip_sample_t*, long, int gain, int* peak );
+	
 private:
 	enum { buf_count = 3 };
 	Blip_Buffer bufs [buf_count];
@@ -115,8 +124,11 @@ private:
 	bool stereo_added;
 	bool was_stereo;
 	
+	void remove_read( long count, bool stereo );
 	void mix_stereo( blip_sample_t*, long );
 	void mix_mono( blip_sample_t*, long );
+	void mix_stereo( blip_sample_t*, long, int gain, int* peak );
+	void mix_mono( blip_sample_t*, long, int gain, int* peak );
 };
 
 // Silent_Buffer generates no samples, useful where no sound is wanted
@@ -19,12 +19,12 @@ struct gb_apu_wrapper {
 
 extern "C" {
 
-GB_EXPORT gb_apu_wrapper_t* gb_apu_wrapper_create(int sample_rate) {
+GB_EXPORT gb_apu_wrapper_t* gb_apu_wrapper_create(int sample_rate, int buffer_msec) {
     gb_apu_wrapper_t *w = new (std::nothrow) gb_apu_wrapper_t;
     if (!w) return NULL;
 
     w->buf.clock_rate(GB_CPU_CLOCK);
-    if (w->buf.set_sample_rate(sample_rate)) {
+    if (w->buf.set_sample_rate(sample_rate, buffer_msec)) {
         delete w;
         return NULL;
     }
@@ -49,7 +49,9 @@ GB_EXPORT void gb_apu_wrapper_destroy(gb_apu_wrapper_t *w) {
 GB_EXPORT void gb_apu_wrapper_reset(gb_apu_wrapper_t *w) {
     if (!w) return;
     w->apu.reset();
-    w->buf.clear();
+    /* Only called between frames, so nothing has been synthesized past the
+     * samples waiting to be read; no need to clear the whole buffer. */
+    w->buf.clear(false);
 
     /* Re-enable after reset */
     w->apu.write_register(0, 0xFF26, 0x80);
@@ -68,6 +70,12 @@ GB_EXPORT void gb_apu_wrapper_end_frame(gb_apu_wrapper_t *w, long cycles) {
     w->buf.end_frame((blip_time_t)cycles, stereo);
 }
 
+GB_EXPORT long gb_apu_wrapper_count_clocks(gb_apu_wrapper_t *w, int samples) {
+    if (!w) return 0;
+    /* Center, left and right advance together, so any of them will do */
+    return (long)w->buf.center()->count_clocks(samples);
+}
+
 GB_EXPORT int gb_apu_wrapper_samples_avail(gb_apu_wrapper_t *w) {
     if (!w) return 0;
     return (int)w->buf.samples_avail();
@@ -80,4 +88,18 @@ GB_EXPORT int gb_apu_wrapper_read_samples(gb_apu_wrapper_t *w, int16_t *out, int
     return (int)w->buf.read_samples((blip_sample_t*)out, count);
 }
 
+GB_EXPORT int gb_apu_wrapper_read_samples_gain(gb_apu_wrapper_t *w, int16_t *out, int count, int gain, int *peak) {
+    if (!w) return 0;
+    return (int)w->buf.read_samples((blip_sample_t*)out, count, gain, peak);
+}
+
+GB_EXPORT void gb_apu_wrapper_remove_samples(gb_apu_wrapper_t *w, int count) {
+    if (!w || count <= 0) return;
+    /* count is in shorts; each Blip_Buffer holds one sample per frame */
+    long frames = count / 2;
+    w->buf.center()->remove_samples(frames);
+    w->buf.left()->remove_samples(frames);
+    w->buf.right()->remove_samples(frames);
+}
+
 } /* extern "C" */
@@ -13,13 +13,14 @@ extern "C" {
 
 typedef struct gb_apu_wrapper gb_apu_wrapper_t;
 
-/* Create a new GB APU instance at the given sample rate */
-gb_apu_wrapper_t* gb_apu_wrapper_create(int sample_rate);
+/* Create a new GB APU instance at the given sample rate. buffer_msec sets the
+ * length of each Blip_Buffer; 0 makes them as large as possible (~65000 samples). */
+gb_apu_wrapper_t* gb_apu_wrapper_create(int sample_rate, int buffer_msec);
 
 /* Destroy an instance */
 void gb_apu_wrapper_destroy(gb_apu_wrapper_t *w);
 
-/* Reset the APU */
+/* Reset the APU and drop buffered samples in place (no allocation) */
 void gb_apu_wrapper_reset(gb_apu_wrapper_t *w);
 
 /* Write to a register (addr: 0xFF10-0xFF3F, time: cycle offset within frame) */
@@ -28,12 +29,23 @@ void gb_apu_wrapper_write(gb_apu_wrapper_t *w, unsigned addr, int data, long tim
 /* End the current frame (cycles = total GB CPU cycles in this frame) */
 void gb_apu_wrapper_end_frame(gb_apu_wrapper_t *w, long cycles);
 
+/* Number of GB CPU cycles to run until 'samples' stereo frames are available */
+long gb_apu_wrapper_count_clocks(gb_apu_wrapper_t *w, int samples);
+
 /* Number of samples available to read (stereo: count of individual shorts) */
 int gb_apu_wrapper_samples_avail(gb_apu_wrapper_t *w);
 
 /* Read stereo samples (interleaved L/R int16). Returns number of shorts read. */
 int gb_apu_wrapper_read_samples(gb_apu_wrapper_t *w, int16_t *out, int count);
 
+/* Read like gb_apu_wrapper_read_samples, multiplying each sample by gain
+ * (1-32767) with saturation in the same pass. If peak is not NULL it is
+ * raised to the largest magnitude read before the gain. Returns shorts read. */
+int gb_apu_wrapper_read_samples_gain(gb_apu_wrapper_t *w, int16_t *out, int count, int gain, int *peak);
+
+/* Discard buffered samples without reading them (count of shorts, as above) */
+void gb_apu_wrapper_remove_samples(gb_apu_wrapper_t *w, int count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,539 @@
+/*
+ * Chiptune render benchmark (host-native)
+ *
+ * Loads a natively built dsp.so, drives v2_render_block for every factory
+ * preset under scripted MIDI loads and reports per-block timing against the
+ * audio-thread budget (frames / sample_rate).
+ *
+ * Build and run with ./scripts/bench.sh
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <new>
+
+#include "plugin_api.h"
+
+#define DEFAULT_SAMPLE_RATE 44100
+#define DEFAULT_FRAMES      128
+#define DEFAULT_BLOCKS      2000
+#define WARMUP_BLOCKS       32
+#define MAX_FRAMES          4096
+
+/* =====================================================================
+ * Allocation counting
+ *
+ * The benchmark is linked with -rdynamic, so these replace operator new
+ * for the dlopened plugin as well.
+ * ===================================================================== */
+
+static volatile long g_alloc_count = 0;
+
+static void *counted_alloc(size_t size) {
+    g_alloc_count = g_alloc_count + 1;
+    return malloc(size ? size : 1);
+}
+
+void *operator new(size_t size) {
+    void *p = counted_alloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void *operator new[](size_t size) {
+    void *p = counted_alloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void *operator new(size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size); }
+void *operator new[](size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+/* =====================================================================
+ * Scripted MIDI loads
+ * ===================================================================== */
+
+typedef void (*scenario_fn)(const plugin_api_v2_t *api, void *inst, int block);
+
+struct scenario_t {
+    const char *name;
+    scenario_fn step;
+};
+
+static void send_note(const plugin_api_v2_t *api, void *inst, int on, int note, int vel) {
+    uint8_t msg[3];
+    msg[0] = on ? 0x90 : 0x80;
+    msg[1] = (uint8_t)note;
+    msg[2] = (uint8_t)(on ? vel : 0);
+    api->on_midi(inst, msg, 3, 0);
+}
+
+static void scenario_idle(const plugin_api_v2_t *api, void *inst, int block) {
+    (void)api; (void)inst; (void)block;
+}
+
+/* One held note at a time: 200 blocks on, 50 blocks off */
+static void scenario_mono(const plugin_api_v2_t *api, void *inst, int block) {
+    static const int notes[] = {48, 60, 67, 72, 84};
+    int cycle = block / 250;
+    int pos = block % 250;
+    int note = notes[cycle % 5];
+    if (pos == 0) send_note(api, inst, 1, note, 110);
+    if (pos == 200) send_note(api, inst, 0, note, 0);
+}
+
+/* Four-note chords: 100 blocks on, 20 blocks off */
+static void scenario_poly(const plugin_api_v2_t *api, void *inst, int block) {
+    static const int chord[] = {0, 4, 7, 11};
+    int cycle = block / 120;
+    int pos = block % 120;
+    int root = 48 + (cycle % 4) * 5;
+    for (int i = 0; i < 4; i++) {
+        if (pos == 0) send_note(api, inst, 1, root + chord[i], 100);
+        if (pos == 100) send_note(api, inst, 0, root + chord[i], 0);
+    }
+}
+
+/* New note every other block, releasing the previous one */
+static void scenario_retrigger(const plugin_api_v2_t *api, void *inst, int block) {
+    if (block & 1) return;
+    int step = block / 2;
+    int note = 60 + (step % 40);
+    int prev = 60 + ((step + 39) % 40);
+    if (step > 0) send_note(api, inst, 0, prev, 0);
+    send_note(api, inst, 1, note, 64 + (step % 64));
+}
+
+/* Poly chords with deep vibrato, switching LFO shape every chord */
+static void scenario_vibrato(const plugin_api_v2_t *api, void *inst, int block) {
+    static const char *shapes[] = {"Sine", "Triangle", "Square", "S&H"};
+    if (block % 120 == 0) {
+        api->set_param(inst, "vibrato_depth", "12");
+        api->set_param(inst, "vibrato_rate", "8");
+        api->set_param(inst, "vibrato_shape", shapes[(block / 120) % 4]);
+    }
+    scenario_poly(api, inst, block);
+}
+
+/* Vibrato chords with a pitch envelope, updated every 16 samples */
+static void scenario_fine_mod(const plugin_api_v2_t *api, void *inst, int block) {
+    if (block == 0) {
+        api->set_param(inst, "control_rate", "16");
+        api->set_param(inst, "pitch_env_depth", "12");
+        api->set_param(inst, "pitch_env_speed", "4");
+    }
+    scenario_vibrato(api, inst, block);
+}
+
+static const scenario_t g_scenarios[] = {
+    {"idle",      scenario_idle},
+    {"mono",      scenario_mono},
+    {"poly",      scenario_poly},
+    {"retrigger", scenario_retrigger},
+    {"vibrato",   scenario_vibrato},
+    {"fine-mod",  scenario_fine_mod},
+};
+
+#define NUM_SCENARIOS ((int)(sizeof(g_scenarios) / sizeof(g_scenarios[0])))
+
+/* =====================================================================
+ * Timing and statistics
+ * ===================================================================== */
+
+static inline int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Value at percentile p (0-100) of a sorted array */
+static int64_t percentile(const int64_t *sorted, int count, double p) {
+    if (count <= 0) return 0;
+    int idx = (int)(p / 100.0 * (count - 1) + 0.5);
+    if (idx < 0) idx = 0;
+    if (idx >= count) idx = count - 1;
+    return sorted[idx];
+}
+
+/* Histogram buckets as a percentage of the block budget */
+static const double g_bucket_limits[] = {0.5, 1.0, 2.0, 5.0, 10.0, 25.0, 50.0, 100.0};
+#define NUM_BUCKETS ((int)(sizeof(g_bucket_limits) / sizeof(g_bucket_limits[0])) + 1)
+
+static void print_histogram(const int64_t *sorted, int count, double budget_ns) {
+    int buckets[NUM_BUCKETS];
+    memset(buckets, 0, sizeof(buckets));
+    for (int i = 0; i < count; i++) {
+        double pct = (double)sorted[i] * 100.0 / budget_ns;
+        int b = 0;
+        while (b < NUM_BUCKETS - 1 && pct >= g_bucket_limits[b]) b++;
+        buckets[b]++;
+    }
+    printf("\nBlock time histogram (%% of %.0f ns budget, %d blocks):\n", budget_ns, count);
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        char label[32];
+        if (b == 0) {
+            snprintf(label, sizeof(label), "< %.1f%%", g_bucket_limits[0]);
+        } else if (b == NUM_BUCKETS - 1) {
+            snprintf(label, sizeof(label), ">= %.0f%%", g_bucket_limits[b - 1]);
+        } else {
+            snprintf(label, sizeof(label), "%.1f-%.1f%%", g_bucket_limits[b - 1], g_bucket_limits[b]);
+        }
+        double share = count ? buckets[b] * 100.0 / count : 0.0;
+        int bar = (int)(share / 2.0 + 0.5);
+        printf("  %-12s %8d  %6.2f%%  ", label, buckets[b], share);
+        for (int i = 0; i < bar; i++) putchar('#');
+        putchar('\n');
+    }
+}
+
+/* =====================================================================
+ * Preset switching
+ * ===================================================================== */
+
+/* Scroll through every preset while playing, as with the jog wheel, then
+ * restore state. Reports time per switch and any heap allocations, which
+ * must be zero: set_param may be called close to the audio thread. */
+static int bench_preset_switching(const plugin_api_v2_t *api, const char *module_dir,
+                                  int preset_count, int frames) {
+    static int16_t out[MAX_FRAMES * 2];
+    char buf[32];
+    char state[2048];
+    void *inst = api->create_instance(module_dir, NULL);
+    if (!inst) return -1;
+
+    int switches = 0;
+    int64_t worst = 0;
+    int64_t total = 0;
+    long allocs_before = g_alloc_count;
+
+    for (int round = 0; round < 4; round++) {
+        for (int p = 0; p < preset_count; p++) {
+            send_note(api, inst, 1, 60, 100);
+            api->render_block(inst, out, frames);
+
+            snprintf(buf, sizeof(buf), "%d", (p + 1) % preset_count);
+            int64_t t0 = now_ns();
+            api->set_param(inst, "preset", buf);
+            int64_t dt = now_ns() - t0;
+            total += dt;
+            if (dt > worst) worst = dt;
+            switches++;
+
+            api->render_block(inst, out, frames);
+        }
+    }
+
+    int state_len = api->get_param(inst, "state", state, sizeof(state));
+    int64_t state_ns = 0;
+    if (state_len > 0) {
+        int64_t t0 = now_ns();
+        api->set_param(inst, "state", state);
+        state_ns = now_ns() - t0;
+    }
+    api->render_block(inst, out, frames);
+
+    long allocs = g_alloc_count - allocs_before;
+    api->destroy_instance(inst);
+
+    printf("\nPreset switching: %d switches, mean %.0f ns, max %lld ns; state restore %lld ns\n",
+           switches, (double)total / switches, (long long)worst, (long long)state_ns);
+    printf("Heap allocations while switching presets/restoring state: %ld%s\n",
+           allocs, allocs ? "  <-- FAIL" : "");
+    return allocs ? 1 : 0;
+}
+
+/* =====================================================================
+ * Parameter traffic
+ * ===================================================================== */
+
+/* Keys a host touches when polling knobs and the UI, including the JSON
+ * it fetches for the chain editor and to save the patch */
+static const char *const g_traffic_keys[] = {
+    "duty", "env_attack", "volume", "detune", "control_rate",
+    "preset", "preset_name", "chip", "underrun_blocks", "reg_writes_suppressed",
+    "state", "chain_params", "ui_hierarchy",
+};
+#define NUM_TRAFFIC_KEYS (int)(sizeof(g_traffic_keys) / sizeof(g_traffic_keys[0]))
+
+/* Mean cost of get_param and set_param across the keys above. Set writes
+ * back the value just read, so the instance state does not change. */
+static void bench_param_traffic(const plugin_api_v2_t *api, const char *module_dir) {
+    static char buf[4096];
+    void *inst = api->create_instance(module_dir, NULL);
+    if (!inst) return;
+
+    const int rounds = 2000;
+    int64_t get_ns = 0, set_ns = 0;
+    int gets = 0, sets = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (int k = 0; k < NUM_TRAFFIC_KEYS; k++) {
+            int64_t t0 = now_ns();
+            int len = api->get_param(inst, g_traffic_keys[k], buf, sizeof(buf));
+            int64_t t1 = now_ns();
+            get_ns += t1 - t0;
+            gets++;
+            /* Skip read-only keys and "preset", which reloads the patch */
+            if (len <= 0 || k >= 5) continue;
+            t0 = now_ns();
+            api->set_param(inst, g_traffic_keys[k], buf);
+            set_ns += now_ns() - t0;
+            sets++;
+        }
+    }
+    api->destroy_instance(inst);
+
+    printf("Param traffic: get_param mean %.0f ns, set_param mean %.0f ns (%d keys)\n",
+           (double)get_ns / gets, sets ? (double)set_ns / sets : 0.0, NUM_TRAFFIC_KEYS);
+}
+
+/* =====================================================================
+ * Instance creation
+ * ===================================================================== */
+
+/* Mean cost of create_instance + destroy_instance while another instance
+ * is alive, as when a second chain slot loads the module */
+static void bench_instance_create(const plugin_api_v2_t *api, const char *module_dir) {
+    void *keep = api->create_instance(module_dir, NULL);
+    if (!keep) return;
+
+    const int rounds = 200;
+    int64_t create_ns = 0, destroy_ns = 0;
+    int n = 0;
+    for (; n < rounds; n++) {
+        int64_t t0 = now_ns();
+        void *inst = api->create_instance(module_dir, NULL);
+        int64_t t1 = now_ns();
+        if (!inst) break;
+        api->destroy_instance(inst);
+        create_ns += t1 - t0;
+        destroy_ns += now_ns() - t1;
+    }
+    api->destroy_instance(keep);
+    if (n == 0) return;
+
+    printf("Instance create: mean %.1f us, destroy mean %.1f us\n",
+           (double)create_ns / n / 1000.0, (double)destroy_ns / n / 1000.0);
+}
+
+/* =====================================================================
+ * Main
+ * ===================================================================== */
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Usage: %s [options] [dsp.so]\n"
+        "  -b N      blocks per scenario (default %d)\n"
+        "  -p N      only run preset N\n"
+        "  -s NAME   only run scenario NAME (idle, mono, poly, retrigger, vibrato, fine-mod)\n"
+        "  -r RATE   host sample rate (default %d)\n"
+        "  -f N      frames per block (default %d)\n"
+        "  -m DIR    module directory passed to create_instance\n",
+        prog, DEFAULT_BLOCKS, DEFAULT_SAMPLE_RATE, DEFAULT_FRAMES);
+}
+
+int main(int argc, char **argv) {
+    const char *so_path = "build/host/dsp.so";
+    const char *module_dir = "src";
+    const char *only_scenario = NULL;
+    int only_preset = -1;
+    int blocks = DEFAULT_BLOCKS;
+    int sample_rate = DEFAULT_SAMPLE_RATE;
+    int frames = DEFAULT_FRAMES;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (a[0] == '-' && a[1] && !a[2] && i + 1 < argc) {
+            const char *v = argv[++i];
+            switch (a[1]) {
+                case 'b': blocks = atoi(v); break;
+                case 'p': only_preset = atoi(v); break;
+                case 's': only_scenario = v; break;
+                case 'r': sample_rate = atoi(v); break;
+                case 'f': frames = atoi(v); break;
+                case 'm': module_dir = v; break;
+                default: usage(argv[0]); return 2;
+            }
+        } else if (a[0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            so_path = a;
+        }
+    }
+    if (blocks < 1 || frames < 1 || frames > MAX_FRAMES || sample_rate < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    void *handle = dlopen(so_path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        fprintf(stderr, "dlopen failed: %s\n", dlerror());
+        return 1;
+    }
+    move_plugin_init_v2_fn init_fn = (move_plugin_init_v2_fn)dlsym(handle, "move_plugin_init_v2");
+    if (!init_fn) {
+        fprintf(stderr, "move_plugin_init_v2 not found in %s\n", so_path);
+        return 1;
+    }
+
+    static host_api_v1_t host;
+    memset(&host, 0, sizeof(host));
+    host.api_version = 1;
+    host.sample_rate = sample_rate;
+    host.frames_per_block = frames;
+
+    const plugin_api_v2_t *api = init_fn(&host);
+    if (!api || api->api_version != 2) {
+        fprintf(stderr, "Plugin did not return a v2 API\n");
+        return 1;
+    }
+
+    /* Find preset count from a probe instance */
+    char buf[256];
+    void *probe = api->create_instance(module_dir, NULL);
+    if (!probe) {
+        fprintf(stderr, "create_instance failed\n");
+        return 1;
+    }
+    int preset_count = 0;
+    if (api->get_param(probe, "preset_count", buf, sizeof(buf)) > 0) {
+        preset_count = atoi(buf);
+    }
+    api->destroy_instance(probe);
+
+    double budget_ns = (double)frames * 1e9 / (double)sample_rate;
+    int64_t *times = (int64_t*)malloc(sizeof(int64_t) * blocks);
+    int64_t *all_times = (int64_t*)malloc(sizeof(int64_t) * (size_t)blocks *
+                                          (preset_count > 0 ? preset_count : 1) * NUM_SCENARIOS);
+    int all_count = 0;
+    static int16_t out[MAX_FRAMES * 2];
+
+    printf("Chiptune render benchmark: %s\n", so_path);
+    printf("%d Hz, %d frames/block, budget %.1f us/block, %d blocks/scenario\n\n",
+           sample_rate, frames, budget_ns / 1000.0, blocks);
+    printf("%-3s %-18s %-10s %9s %9s %9s %9s %9s %9s %7s\n",
+           "#", "preset", "scenario", "mean ns", "p50", "p90", "p99", "p99.9", "max", "budget");
+
+    int64_t worst_ns = 0;
+    long underruns = 0;
+    long overruns = 0;
+    long writes_issued = 0;
+    long writes_suppressed = 0;
+    char worst_label[96] = "";
+
+    for (int p = 0; p < preset_count; p++) {
+        if (only_preset >= 0 && p != only_preset) continue;
+
+        for (int s = 0; s < NUM_SCENARIOS; s++) {
+            if (only_scenario && strcmp(only_scenario, g_scenarios[s].name) != 0) continue;
+
+            void *inst = api->create_instance(module_dir, NULL);
+            if (!inst) {
+                fprintf(stderr, "create_instance failed\n");
+                return 1;
+            }
+            snprintf(buf, sizeof(buf), "%d", p);
+            api->set_param(inst, "preset", buf);
+
+            char name[64] = "";
+            api->get_param(inst, "preset_name", name, sizeof(name));
+
+            for (int b = 0; b < WARMUP_BLOCKS; b++) {
+                api->render_block(inst, out, frames);
+            }
+
+            int64_t total = 0;
+            for (int b = 0; b < blocks; b++) {
+                g_scenarios[s].step(api, inst, b);
+                int64_t t0 = now_ns();
+                api->render_block(inst, out, frames);
+                int64_t dt = now_ns() - t0;
+                times[b] = dt;
+                total += dt;
+            }
+
+            char count[32];
+            if (api->get_param(inst, "underrun_blocks", count, sizeof(count)) > 0) {
+                underruns += atol(count);
+            }
+            if (api->get_param(inst, "overrun_blocks", count, sizeof(count)) > 0) {
+                overruns += atol(count);
+            }
+            if (api->get_param(inst, "reg_writes_issued", count, sizeof(count)) > 0) {
+                writes_issued += atol(count);
+            }
+            if (api->get_param(inst, "reg_writes_suppressed", count, sizeof(count)) > 0) {
+                writes_suppressed += atol(count);
+            }
+            api->destroy_instance(inst);
+
+            memcpy(all_times + all_count, times, sizeof(int64_t) * blocks);
+            all_count += blocks;
+
+            qsort(times, blocks, sizeof(int64_t), cmp_i64);
+            int64_t max_ns = times[blocks - 1];
+            double mean = (double)total / blocks;
+            printf("%-3d %-18s %-10s %9.0f %9lld %9lld %9lld %9lld %9lld %6.2f%%\n",
+                   p, name, g_scenarios[s].name, mean,
+                   (long long)percentile(times, blocks, 50.0),
+                   (long long)percentile(times, blocks, 90.0),
+                   (long long)percentile(times, blocks, 99.0),
+                   (long long)percentile(times, blocks, 99.9),
+                   (long long)max_ns,
+                   mean * 100.0 / budget_ns);
+
+            if (max_ns > worst_ns) {
+                worst_ns = max_ns;
+                snprintf(worst_label, sizeof(worst_label), "%d %s / %s", p, name, g_scenarios[s].name);
+            }
+        }
+    }
+
+    if (all_count > 0) {
+        qsort(all_times, all_count, sizeof(int64_t), cmp_i64);
+        int64_t total = 0;
+        for (int i = 0; i < all_count; i++) total += all_times[i];
+        printf("\nAll blocks: mean %.0f ns, p50 %lld, p99 %lld, p99.9 %lld, max %lld ns (%.2f%% of budget)\n",
+               (double)total / all_count,
+               (long long)percentile(all_times, all_count, 50.0),
+               (long long)percentile(all_times, all_count, 99.0),
+               (long long)percentile(all_times, all_count, 99.9),
+               (long long)all_times[all_count - 1],
+               all_times[all_count - 1] * 100.0 / budget_ns);
+        printf("Worst block: %lld ns in preset %s\n", (long long)worst_ns, worst_label);
+        print_histogram(all_times, all_count, budget_ns);
+    }
+
+    int status = 0;
+    printf("\nBlip_Buffer readout: %ld underrun, %ld overrun blocks%s\n",
+           underruns, overruns, (underruns || overruns) ? "  <-- FAIL" : "");
+    if (underruns || overruns) status = 1;
+    if (writes_issued + writes_suppressed > 0) {
+        printf("APU register writes: %ld issued, %ld suppressed as redundant (%.1f%%)\n",
+               writes_issued, writes_suppressed,
+               writes_suppressed * 100.0 / (writes_issued + writes_suppressed));
+    }
+
+    if (only_preset < 0 && !only_scenario) {
+        if (bench_preset_switching(api, module_dir, preset_count, frames)) status = 1;
+        bench_param_traffic(api, module_dir);
+        bench_instance_create(api, module_dir);
+    }
+
+    free(times);
+    free(all_times);
+    dlclose(handle);
+    return status;
+}
@@ -0,0 +1,108 @@
+/*
+ * Envelope equivalence check (host-native)
+ *
+ * For every ADSR setting (16^4), plays a gate-on / release / retrigger /
+ * release script and checks that env_advance() over blocks of varying size
+ * leaves exactly the same level and stage as env_process() per sample.
+ *
+ * Build and run with ./scripts/check.sh
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "envelope.h"
+
+#define SAMPLE_RATE 44100
+
+/* Block sizes cycled through by the block-wise side of the check */
+static const int g_block_sizes[] = { 128, 1, 64, 7, 333, 128, 4096, 2, 256, 16 };
+#define NUM_BLOCK_SIZES (int)(sizeof(g_block_sizes) / sizeof(g_block_sizes[0]))
+
+static uint32_t g_rng = 0x12345678u;
+
+static uint32_t rng_next(void) {
+    g_rng = g_rng * 1664525u + 1013904223u;
+    return g_rng >> 8;
+}
+
+static int g_failures = 0;
+static long g_samples = 0;
+
+/* Run `samples` samples both ways from the current (identical) states */
+static int run_phase(voice_envelope_t *ref, voice_envelope_t *fast, int samples,
+                     int a, int d, int s, int r, const char *phase, int *block_idx) {
+    int done = 0;
+    while (done < samples) {
+        int n = g_block_sizes[*block_idx % NUM_BLOCK_SIZES];
+        (*block_idx)++;
+        if (n > samples - done) n = samples - done;
+
+        for (int i = 0; i < n; i++) env_process(ref);
+        int32_t level = env_advance(fast, n);
+        done += n;
+
+        if (ref->level != fast->level || ref->stage != fast->stage || level != fast->level) {
+            if (g_failures < 10) {
+                printf("MISMATCH a=%d d=%d s=%d r=%d %s +%d: process level=%d stage=%d, "
+                       "advance level=%d stage=%d\n",
+                       a, d, s, r, phase, done, (int)ref->level, ref->stage,
+                       (int)fast->level, fast->stage);
+            }
+            g_failures++;
+            return -1;
+        }
+    }
+    g_samples += samples;
+    return 0;
+}
+
+/* Samples until release finishes from any level, plus a margin */
+static int release_len(const voice_envelope_t *env) {
+    return (int)(ENV_ONE / env->release_dec) + 2;
+}
+
+int main(void) {
+    long settings = 0;
+
+    for (int a = 0; a < 16; a++)
+    for (int d = 0; d < 16; d++)
+    for (int s = 0; s < 16; s++)
+    for (int r = 0; r < 16; r++) {
+        voice_envelope_t ref, fast;
+        env_init(&ref);
+        env_configure(&ref, a, d, s, r, SAMPLE_RATE);
+        fast = ref;
+        int bi = (int)(rng_next() % NUM_BLOCK_SIZES);
+        settings++;
+
+        /* Note on, held for a random time up to past the end of decay */
+        int hold = (int)(rng_next() % (SAMPLE_RATE * 3 / 2));
+        env_gate_on(&ref); env_gate_on(&fast);
+        if (run_phase(&ref, &fast, hold, a, d, s, r, "hold", &bi)) continue;
+
+        /* Release, cut short by a retrigger about half the time */
+        env_gate_off(&ref); env_gate_off(&fast);
+        int rel = (rng_next() & 1) ? (int)(rng_next() % (SAMPLE_RATE / 2)) : release_len(&ref);
+        if (run_phase(&ref, &fast, rel, a, d, s, r, "release", &bi)) continue;
+
+        /* Retrigger from wherever release got to, then release to idle */
+        env_gate_on(&ref); env_gate_on(&fast);
+        hold = (int)(rng_next() % (SAMPLE_RATE / 2));
+        if (run_phase(&ref, &fast, hold, a, d, s, r, "retrigger", &bi)) continue;
+        env_gate_off(&ref); env_gate_off(&fast);
+        if (run_phase(&ref, &fast, release_len(&ref), a, d, s, r, "final release", &bi)) continue;
+
+        if (ref.stage != ENV_IDLE || ref.level != 0) {
+            if (g_failures < 10) {
+                printf("NOT IDLE a=%d d=%d s=%d r=%d: level=%d stage=%d\n",
+                       a, d, s, r, (int)ref.level, ref.stage);
+            }
+            g_failures++;
+        }
+    }
+
+    printf("envelope: %ld ADSR settings, %ld samples compared, %d failure%s\n",
+           settings, g_samples, g_failures, g_failures == 1 ? "" : "s");
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,318 @@
+/*
+ * GB oscillator microbenchmarks (host-native)
+ *
+ * Times the Game Boy APU's inner loops in isolation, without the plugin or
+ * Gb_Apu around them:
+ *   Gb_Square::run, Gb_Wave::run, Gb_Noise::run  across their period range
+ *   Gb_Wave::run (loop cache)                      held notes, replayed from Gb_Loop
+ *   Blip_Synth::offset_resampled                   both synth qualities used
+ *   Gb_Apu::write_register                         all four channels playing, N writes per block
+ *   Stereo_Buffer::read_samples                    mono and stereo mix, plain and with gain
+ *
+ * Each oscillator runs for RUN_FRAMES frames of one 128-sample block,
+ * writing into a Blip_Buffer that is emptied after every frame as in the
+ * plugin. Reported per configuration: oscillator steps (loop iterations)
+ * and transitions (synth offsets) per second of CPU time, and ns per
+ * output sample. The "frame overhead" row is end_frame + remove_samples
+ * alone, which every oscillator row includes.
+ *
+ * Build and run with ./scripts/bench.sh
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "Gb_Apu.h"   /* gb_time_t, then Gb_Oscs.h */
+#include "Multi_Buffer.h"
+
+#define SAMPLE_RATE   44100
+#define GB_CLOCK      4194304
+#define BLOCK_FRAMES  128
+#define FRAME_CLOCKS  ((long)GB_CLOCK * BLOCK_FRAMES / SAMPLE_RATE)
+#define RUN_FRAMES    20000
+#define SYNTH_VOLUME  0.15   /* what Gb_Apu::volume(1.0) gives each synth */
+
+static inline int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void print_header(void) {
+    printf("%-30s %-22s %12s %14s %10s\n",
+           "component", "config", "steps/s", "transitions/s", "ns/sample");
+}
+
+static void print_row(const char *component, const char *config, int64_t ns,
+                      double steps, double transitions, long samples) {
+    double sec = ns / 1e9;
+    char s[32] = "-", t[32] = "-";
+    if (steps > 0) snprintf(s, sizeof(s), "%.3g", steps / sec);
+    if (transitions > 0) snprintf(t, sizeof(t), "%.3g", transitions / sec);
+    printf("%-30s %-22s %12s %14s %10.2f\n", component, config, s, t, (double)ns / samples);
+}
+
+/* =====================================================================
+ * Oscillators
+ * ===================================================================== */
+
+static Blip_Buffer g_buf;
+static Gb_Square::Synth g_square_synth;
+static Gb_Wave::Synth g_other_synth;
+static Gb_Loop g_loop;
+
+static void osc_attach(Gb_Osc &osc) {
+    osc.outputs[1] = osc.outputs[2] = osc.outputs[3] = &g_buf;
+    osc.reset();  /* selects outputs[3] */
+}
+
+/* Run osc for RUN_FRAMES frames; returns elapsed ns */
+static int64_t run_frames(Gb_Osc *osc) {
+    g_buf.clear();
+    int64_t t0 = now_ns();
+    for (int f = 0; f < RUN_FRAMES; f++) {
+        if (osc) osc->run(0, FRAME_CLOCKS);
+        g_buf.end_frame(FRAME_CLOCKS);
+        g_buf.remove_samples(g_buf.samples_avail());
+    }
+    return now_ns() - t0;
+}
+
+static const long g_samples = (long)RUN_FRAMES * BLOCK_FRAMES;
+static const double g_clocks = (double)RUN_FRAMES * FRAME_CLOCKS;
+
+static void bench_square(int frequency) {
+    Gb_Square sq;
+    osc_attach(sq);
+    sq.synth = &g_square_synth;
+    sq.write_register(1, 0x80);                   /* 50% duty */
+    sq.write_register(2, 0xF0);                   /* volume 15, no envelope */
+    sq.write_register(3, frequency & 0xFF);
+    sq.write_register(4, 0x80 | (frequency >> 8));
+    int period = sq.period;
+
+    int64_t ns = run_frames(&sq);
+    double steps = g_clocks / period;
+    char config[32];
+    snprintf(config, sizeof(config), "period %d", period);
+    /* 50% duty: 2 of every 8 steps toggle */
+    print_row("Gb_Square::run", config, ns, steps, steps / 4, g_samples);
+}
+
+static void bench_wave(int frequency, bool cached) {
+    Gb_Wave wave;
+    osc_attach(wave);
+    g_loop.invalidate();
+    if (cached) wave.loop = &g_loop;
+    wave.synth = &g_other_synth;
+    /* Alternating full-scale nibbles, so every step is a transition */
+    for (int i = 0; i < Gb_Wave::wave_size; i++) wave.wave[i] = (i & 1) ? 0 : 15;
+    wave.write_register(0, 0x80);
+    wave.write_register(2, 0x20);                 /* 100% */
+    wave.write_register(3, frequency & 0xFF);
+    wave.write_register(4, 0x80 | (frequency >> 8));
+    int period = wave.period;
+
+    int64_t ns = run_frames(&wave);
+    double steps = g_clocks / period;
+    char config[32];
+    snprintf(config, sizeof(config), "period %d", period);
+    print_row(cached ? "Gb_Wave::run (loop cache)" : "Gb_Wave::run", config, ns, steps, steps, g_samples);
+}
+
+/* Transitions in the same number of LFSR steps, counted untimed */
+static double noise_transitions(int tap, double steps) {
+    unsigned bits = ~0u;
+    const unsigned mask = ~(1u << tap);
+    double count = 0;
+    for (long i = 0; i < (long)steps; i++) {
+        unsigned feedback = bits;
+        bits >>= 1;
+        feedback = 1 & (feedback ^ bits);
+        bits = (feedback << tap) | (bits & mask);
+        count += feedback;
+    }
+    return count;
+}
+
+static void bench_noise(int shift, int short_mode) {
+    Gb_Noise noise;
+    osc_attach(noise);
+    noise.synth = &g_other_synth;
+    noise.write_register(2, 0xF0);
+    noise.write_register(3, (shift << 4) | (short_mode ? 8 : 0));  /* divisor 8 */
+    noise.write_register(4, 0x80);
+    int period = noise.period;
+
+    int64_t ns = run_frames(&noise);
+    double steps = g_clocks / period;
+    char config[32];
+    snprintf(config, sizeof(config), "shift %d%s (period %d)", shift, short_mode ? " 7-bit" : "", period);
+    print_row("Gb_Noise::run", config, ns, steps, noise_transitions(noise.tap, steps), g_samples);
+}
+
+/* =====================================================================
+ * Blip_Synth
+ * ===================================================================== */
+
+/* offset_resampled for 'per_frame' transitions spread over each frame */
+template<class Synth>
+static void bench_offset(const char *component, const Synth &synth, int per_frame) {
+    g_buf.clear();
+    blip_resampled_time_t step = g_buf.resampled_duration(FRAME_CLOCKS) / per_frame;
+    int64_t t0 = now_ns();
+    for (int f = 0; f < RUN_FRAMES; f++) {
+        blip_resampled_time_t t = g_buf.resampled_time(0);
+        int delta = 15 * gb_apu_max_vol;
+        for (int i = 0; i < per_frame; i++) {
+            synth.offset_resampled(t, delta, &g_buf);
+            delta = -delta;
+            t += step;
+        }
+        g_buf.end_frame(FRAME_CLOCKS);
+        g_buf.remove_samples(g_buf.samples_avail());
+    }
+    int64_t ns = now_ns() - t0;
+    char config[32];
+    snprintf(config, sizeof(config), "%d per block", per_frame);
+    print_row(component, config, ns, 0, (double)per_frame * RUN_FRAMES, g_samples);
+}
+
+/* =====================================================================
+ * Gb_Apu
+ * ===================================================================== */
+
+/*
+ * The whole APU with all four channels at mid pitch, and 'per_frame'
+ * register writes spread over each frame. Every write runs the oscillators
+ * up to its time, so the rows with writes minus the row without give the
+ * per-write overhead of Gb_Apu::run_until.
+ */
+static void bench_writes(int per_frame) {
+    static Gb_Apu apu;
+    apu.reset();
+    apu.output(&g_buf);
+    g_buf.clear();
+
+    static const unsigned char init[][2] = {
+        {0x26, 0x80}, {0x24, 0x77}, {0x25, 0xFF},
+        {0x11, 0x80}, {0x12, 0xF0}, {0x13, 0x00}, {0x14, 0x86},  /* square 1 */
+        {0x16, 0x40}, {0x17, 0xF0}, {0x18, 0x00}, {0x19, 0x87},  /* square 2 */
+        {0x1A, 0x80}, {0x1C, 0x20}, {0x1D, 0x00}, {0x1E, 0x87},  /* wave */
+        {0x21, 0xF0}, {0x22, 0x55}, {0x23, 0x80},                /* noise */
+    };
+    for (int i = 0; i < Gb_Wave::wave_size / 2; i++) apu.write_register(0, 0xFF30 + i, i * 0x11);
+    for (unsigned i = 0; i < sizeof(init) / sizeof(init[0]); i++) {
+        apu.write_register(0, 0xFF00 + init[i][0], init[i][1]);
+    }
+
+    int64_t t0 = now_ns();
+    for (int f = 0; f < RUN_FRAMES; f++) {
+        for (int i = 0; i < per_frame; i++) {
+            /* square 2 frequency low byte, unchanged */
+            apu.write_register(FRAME_CLOCKS * i / per_frame, 0xFF18, 0x00);
+        }
+        apu.end_frame(FRAME_CLOCKS);
+        g_buf.end_frame(FRAME_CLOCKS);
+        g_buf.remove_samples(g_buf.samples_avail());
+    }
+    int64_t ns = now_ns() - t0;
+    char config[32];
+    snprintf(config, sizeof(config), "%d writes per block", per_frame);
+    print_row("Gb_Apu::write_register", config, ns, 0, 0, g_samples);
+}
+
+/* =====================================================================
+ * Stereo_Buffer
+ * ===================================================================== */
+
+static void bench_read(bool stereo, int gain) {
+    Stereo_Buffer buf;
+    buf.clock_rate(GB_CLOCK);
+    buf.set_sample_rate(SAMPLE_RATE, 100);
+    static blip_sample_t out[BLOCK_FRAMES * 2];
+
+    int64_t ns = 0;
+    for (int f = 0; f < RUN_FRAMES; f++) {
+        /* A square wave in each buffer, so the readers see real data */
+        int delta = 15 * gb_apu_max_vol;
+        for (long t = 0; t < FRAME_CLOCKS; t += 512) {
+            g_square_synth.offset(t, delta, buf.center());
+            if (stereo) g_square_synth.offset(t + 100, delta, buf.left());
+            delta = -delta;
+        }
+        buf.end_frame(FRAME_CLOCKS, stereo);
+
+        int peak = 0;
+        int64_t t0 = now_ns();
+        if (gain) buf.read_samples(out, BLOCK_FRAMES * 2, gain, &peak);
+        else buf.read_samples(out, BLOCK_FRAMES * 2);
+        ns += now_ns() - t0;
+        long left = buf.samples_avail() / 2;
+        buf.center()->remove_samples(left);
+        buf.left()->remove_samples(left);
+        buf.right()->remove_samples(left);
+    }
+    char config[32];
+    snprintf(config, sizeof(config), "%s%s", stereo ? "stereo" : "mono", gain ? ", gain" : "");
+    print_row("Stereo_Buffer::read_samples", config, ns, 0, 0, g_samples);
+}
+
+int main(void) {
+    g_buf.clock_rate(GB_CLOCK);
+    if (g_buf.set_sample_rate(SAMPLE_RATE, 100)) {
+        fprintf(stderr, "Blip_Buffer allocation failed\n");
+        return 1;
+    }
+    g_square_synth.volume(SYNTH_VOLUME);
+    g_other_synth.volume(SYNTH_VOLUME);
+
+    printf("GB oscillator microbenchmarks: %d frames of %d samples (%ld clocks) each\n\n",
+           RUN_FRAMES, BLOCK_FRAMES, FRAME_CLOCKS);
+    print_header();
+
+    print_row("frame overhead", "end_frame + remove", run_frames(NULL), 0, 0, g_samples);
+
+    /* period = (2048 - frequency) * 4: 28 (highest audible) to 8188 */
+    static const int square_freqs[] = {2041, 2032, 1920, 1536, 1};
+    for (unsigned i = 0; i < sizeof(square_freqs) / sizeof(square_freqs[0]); i++) {
+        bench_square(square_freqs[i]);
+    }
+
+    /* period = (2048 - frequency) * 2: 8 to 4094 */
+    static const int wave_freqs[] = {2044, 2032, 1920, 1536, 1};
+    for (unsigned i = 0; i < sizeof(wave_freqs) / sizeof(wave_freqs[0]); i++) {
+        bench_wave(wave_freqs[i], false);
+    }
+    /* Held notes: wave periods 8, 32, 148 (A4) and 250 (C4) */
+    static const int wave_cached[] = {2044, 2032, 1974, 1923};
+    for (unsigned i = 0; i < sizeof(wave_cached) / sizeof(wave_cached[0]); i++) {
+        bench_wave(wave_cached[i], false);
+        bench_wave(wave_cached[i], true);
+    }
+
+    /* period = 8 << shift */
+    static const int noise_shifts[] = {0, 1, 2, 4, 8, 13};
+    for (unsigned i = 0; i < sizeof(noise_shifts) / sizeof(noise_shifts[0]); i++) {
+        bench_noise(noise_shifts[i], 0);
+    }
+    bench_noise(0, 1);
+
+    bench_offset("Blip_Synth (good, square)", g_square_synth, 16);
+    bench_offset("Blip_Synth (good, square)", g_square_synth, 256);
+    bench_offset("Blip_Synth (med, wave/noise)", g_other_synth, 16);
+    bench_offset("Blip_Synth (med, wave/noise)", g_other_synth, 256);
+
+    bench_writes(0);
+    bench_writes(16);
+    bench_writes(128);
+
+    bench_read(false, 0);
+    bench_read(true, 0);
+    bench_read(false, 6);
+    bench_read(true, 6);
+    return 0;
+}
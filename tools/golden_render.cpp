@@ -0,0 +1,573 @@
+/*
+ * Golden render check (host-native)
+ *
+ * Renders fixed MIDI scripts through every factory preset on both chips in
+ * every voice allocation mode, and compares each render's fingerprint with
+ * the references in tools/golden/<chip>.txt. A fingerprint is an FNV-1a
+ * hash of the PCM plus an RMS level and 16 log-spaced band levels (dB) from
+ * an averaged spectrum.
+ *
+ * Bit-exact mode (default) requires identical PCM, for pure refactors and
+ * optimisations. Tolerance mode (-t DB) only requires the RMS and band
+ * levels to stay within DB, for intentional DSP changes; bands below
+ * -80 dB in both renders are ignored. References are only bit-exact for
+ * the compiler and CPU that recorded them, so record them (-u) on the
+ * machine you check on before starting work. A chip with no reference file
+ * is skipped with a notice, in the summary line too, and a chip whose
+ * renders are all silent (e.g. a stubbed chip library) is not recorded.
+ *
+ * MIDI timing comes from clock_gettime(CLOCK_MONOTONIC), which this tool
+ * replaces (it is linked with -rdynamic) with a virtual clock, so each
+ * event lands on the sample offset the script gives it. Events are sent
+ * from a second thread, as a host's control thread would: the plugin puts
+ * events sent from the rendering thread at offset 0.
+ *
+ * Usage: golden_render [-u] [-t DB] [-c nes|gb] [-r DIR] [dsp.so]
+ *   -u      record references instead of checking
+ *   -t DB   tolerance mode
+ *   -c CHIP only this chip
+ *   -r DIR  reference directory (default tools/golden)
+ *
+ * Build and run with ./scripts/check.sh
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <pthread.h>
+
+#define PLUGIN_API_VIRTUAL_CLOCK
+#include "plugin_api.h"
+
+#define SAMPLE_RATE    44100
+#define BLOCK_FRAMES   128
+#define RENDER_FRAMES  (SAMPLE_RATE * 3 / 2)
+#define RENDER_BLOCKS  ((RENDER_FRAMES + BLOCK_FRAMES - 1) / BLOCK_FRAMES)
+#define NUM_CHIPS      2
+#define NUM_ALLOC      3
+#define NUM_BANDS      16
+#define FFT_SIZE       2048
+#define BAND_FLOOR_DB  (-80.0)
+#define SILENCE_DB     (-120.0)
+#define MAX_REFS       1024
+
+static const char *const g_chip_names[NUM_CHIPS] = {"NES", "GB"};
+static const char *const g_chip_files[NUM_CHIPS] = {"nes", "gb"};
+static const char *const g_alloc_names[NUM_ALLOC] = {"Auto", "Lead", "Locked"};
+
+/* =====================================================================
+ * Virtual clock (plugin_api.h)
+ * ===================================================================== */
+
+/* Time of a frame, rounded up so the plugin's floor(ns * rate / 1e9) gives
+ * the frame back exactly */
+static int64_t frame_ns(int64_t frame) {
+    return (frame * 1000000000LL + SAMPLE_RATE - 1) / SAMPLE_RATE;
+}
+
+/* =====================================================================
+ * MIDI scripts
+ * ===================================================================== */
+
+typedef struct {
+    int frame;       /* absolute, >= BLOCK_FRAMES (see send_events) */
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+} script_event_t;
+
+#define MS(ms) ((ms) * SAMPLE_RATE / 1000)
+
+/* Legato and detached notes across the range, a repeated note, a pitch
+ * bend sweep and a release tail */
+static const script_event_t g_melody[] = {
+    {MS(10) + 3,   0x90, 60, 100},
+    {MS(160),      0x90, 64, 90},   /* overlaps 60: legato */
+    {MS(170) + 17, 0x80, 60, 0},
+    {MS(320),      0x80, 64, 0},
+    {MS(330) + 1,  0x90, 67, 127},
+    {MS(420),      0x80, 67, 0},
+    {MS(430) + 77, 0x90, 67, 40},   /* repeated note, soft */
+    {MS(520),      0xE0, 0x00, 0x50},
+    {MS(560),      0xE0, 0x00, 0x60},
+    {MS(600),      0xE0, 0x00, 0x70},
+    {MS(640),      0xE0, 0x7F, 0x7F},
+    {MS(700),      0xE0, 0x00, 0x40},
+    {MS(720),      0x80, 67, 0},
+    {MS(730),      0x90, 36, 110},
+    {MS(820) + 99, 0x90, 96, 80},
+    {MS(830),      0x80, 36, 0},
+    {MS(950),      0x80, 96, 0},
+    {MS(960),      0x90, 48, 100},
+    {MS(1000),     0x90, 55, 100},
+    {MS(1040),     0x80, 48, 0},
+    {MS(1100),     0x80, 55, 0},
+};
+
+/* Chords wider than the voice count, so voices are stolen, then low
+ * notes (DMC samples on NES in Auto mode) and all notes off */
+static const script_event_t g_chords[] = {
+    {MS(10),       0x90, 48, 100},
+    {MS(10) + 1,   0x90, 52, 100},
+    {MS(10) + 2,   0x90, 55, 100},
+    {MS(250),      0x90, 60, 90},
+    {MS(250) + 40, 0x90, 64, 90},
+    {MS(250) + 80, 0x90, 67, 90},
+    {MS(400),      0x80, 52, 0},
+    {MS(420),      0x80, 48, 0},
+    {MS(500),      0x80, 55, 0},
+    {MS(500),      0x80, 60, 0},
+    {MS(510),      0x80, 64, 0},
+    {MS(520),      0x80, 67, 0},
+    {MS(600),      0x90, 36, 127},
+    {MS(700),      0x90, 37, 100},
+    {MS(800),      0x90, 38, 100},
+    {MS(850),      0x90, 39, 64},
+    {MS(860),      0x90, 72, 100},
+    {MS(900),      0x80, 36, 0},
+    {MS(900),      0x80, 37, 0},
+    {MS(900),      0x80, 38, 0},
+    {MS(900),      0x80, 39, 0},
+    {MS(1000),     0xB0, 123, 0},
+};
+
+/* The top noise pitches: notes 98 and up give the GB noise period 16,
+ * which runs through the averaged high-pitch path, with legato hand-offs
+ * to and from note 97 (period 32, one step per transition) */
+static const script_event_t g_noise[] = {
+    {MS(10),       0x90, 98, 110},
+    {MS(300),      0x90, 97, 100},
+    {MS(310) + 5,  0x80, 98, 0},
+    {MS(500),      0x90, 100, 90},
+    {MS(510),      0x80, 97, 0},
+    {MS(700),      0x90, 99, 50},   /* softer */
+    {MS(700) + 31, 0x80, 100, 0},
+    {MS(1000),     0x80, 99, 0},
+};
+
+typedef struct {
+    const char *name;
+    const script_event_t *events;
+    int count;
+} script_t;
+
+#define SCRIPT(name, ev) {name, ev, (int)(sizeof(ev) / sizeof(ev[0]))}
+
+static const script_t g_scripts[] = {
+    SCRIPT("melody", g_melody),
+    SCRIPT("chords", g_chords),
+    SCRIPT("noise", g_noise),
+};
+#define NUM_SCRIPTS ((int)(sizeof(g_scripts) / sizeof(g_scripts[0])))
+
+/* =====================================================================
+ * Fingerprints
+ * ===================================================================== */
+
+typedef struct {
+    char key[64];
+    uint64_t hash;
+    double rms_db;
+    double bands[NUM_BANDS];
+} fingerprint_t;
+
+static double power_db(double power) {
+    if (power <= 0.0) return SILENCE_DB;
+    double db = 10.0 * log10(power);
+    return db < SILENCE_DB ? SILENCE_DB : db;
+}
+
+/* In-place radix-2 FFT */
+static void fft(double *re, double *im, int n) {
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j |= bit;
+        if (i < j) {
+            double t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        double a = -2.0 * M_PI / len;
+        for (int i = 0; i < n; i += len) {
+            for (int k = 0; k < len / 2; k++) {
+                double wr = cos(a * k), wi = sin(a * k);
+                double *xr = &re[i + k], *xi = &im[i + k];
+                double *yr = &re[i + k + len / 2], *yi = &im[i + k + len / 2];
+                double tr = *yr * wr - *yi * wi;
+                double ti = *yr * wi + *yi * wr;
+                *yr = *xr - tr;
+                *yi = *xi - ti;
+                *xr += tr;
+                *xi += ti;
+            }
+        }
+    }
+}
+
+/* Band levels of the mono mix: Hann-windowed spectra with 50% overlap,
+ * averaged, summed into NUM_BANDS log-spaced bands from 40 Hz to 20 kHz.
+ * 0 dB is a full-scale sine. */
+static void spectrum_bands(const int16_t *pcm, int frames, double *bands) {
+    static double re[FFT_SIZE], im[FFT_SIZE], power[FFT_SIZE / 2];
+    memset(power, 0, sizeof(power));
+    int windows = 0;
+    for (int start = 0; start + FFT_SIZE <= frames; start += FFT_SIZE / 2) {
+        for (int i = 0; i < FFT_SIZE; i++) {
+            double w = 0.5 - 0.5 * cos(2.0 * M_PI * i / FFT_SIZE);
+            double s = (pcm[(start + i) * 2] + pcm[(start + i) * 2 + 1]) / 65536.0;
+            re[i] = s * w;
+            im[i] = 0.0;
+        }
+        fft(re, im, FFT_SIZE);
+        for (int k = 0; k < FFT_SIZE / 2; k++) power[k] += re[k] * re[k] + im[k] * im[k];
+        windows++;
+    }
+
+    /* Hann window sum is N/2, so a full-scale sine peaks at (N/4)^2 */
+    double norm = (FFT_SIZE / 4.0) * (FFT_SIZE / 4.0) * (windows ? windows : 1);
+    for (int b = 0; b < NUM_BANDS; b++) {
+        double lo = 40.0 * pow(500.0, (double)b / NUM_BANDS);
+        double hi = 40.0 * pow(500.0, (double)(b + 1) / NUM_BANDS);
+        double sum = 0.0;
+        for (int k = 1; k < FFT_SIZE / 2; k++) {
+            double f = (double)k * SAMPLE_RATE / FFT_SIZE;
+            if (f >= lo && f < hi) sum += power[k];
+        }
+        bands[b] = power_db(sum / norm);
+    }
+}
+
+static void fingerprint(const int16_t *pcm, int frames, fingerprint_t *fp) {
+    uint64_t h = 14695981039346656037ULL;
+    double sum = 0.0;
+    for (int i = 0; i < frames * 2; i++) {
+        uint16_t s = (uint16_t)pcm[i];
+        h = (h ^ (s & 0xFF)) * 1099511628211ULL;
+        h = (h ^ (s >> 8)) * 1099511628211ULL;
+        sum += (double)pcm[i] * pcm[i];
+    }
+    fp->hash = h;
+    fp->rms_db = power_db(sum / (frames * 2) / (32768.0 * 32768.0));
+    spectrum_bands(pcm, frames, fp->bands);
+}
+
+/* =====================================================================
+ * Rendering
+ * ===================================================================== */
+
+static int16_t g_pcm[RENDER_BLOCKS * BLOCK_FRAMES * 2];
+
+typedef struct {
+    const plugin_api_v2_t *api;
+    void *inst;
+    const script_t *script;
+    int *next;
+    int block;
+} send_args_t;
+
+/* Events for block b are sent while block b-1 "plays", at the time of
+ * their offset within it: the plugin places an event at the time since
+ * the last render started */
+static void *send_events_thread(void *arg) {
+    const send_args_t *a = (const send_args_t *)arg;
+    int64_t prev_start = frame_ns((int64_t)(a->block - 1) * BLOCK_FRAMES);
+    int block_end = (a->block + 1) * BLOCK_FRAMES;
+    while (*a->next < a->script->count && a->script->events[*a->next].frame < block_end) {
+        const script_event_t *e = &a->script->events[(*a->next)++];
+        g_clock_ns = 1000000000LL + prev_start + frame_ns(e->frame - a->block * BLOCK_FRAMES);
+        uint8_t msg[3] = {e->status, e->data1, e->data2};
+        a->api->on_midi(a->inst, msg, 3, 0);
+    }
+    return NULL;
+}
+
+/* Send from a second thread and wait for it, so the order stays fixed */
+static void send_events(const plugin_api_v2_t *api, void *inst, const script_t *script,
+                        int *next, int block) {
+    send_args_t args = {api, inst, script, next, block};
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, send_events_thread, &args) != 0) {
+        send_events_thread(&args);  /* offsets collapse to 0; the check will say so */
+        return;
+    }
+    pthread_join(thread, NULL);
+}
+
+static int render(const plugin_api_v2_t *api, const char *module_dir, int preset, int chip,
+                  int alloc, const script_t *script, fingerprint_t *fp) {
+    void *inst = api->create_instance(module_dir, NULL);
+    if (!inst) return -1;
+
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%d", preset);
+    api->set_param(inst, "preset", buf);
+    api->set_param(inst, "chip", g_chip_names[chip]);
+    api->set_param(inst, "alloc_mode", g_alloc_names[alloc]);
+
+    int next = 0;
+    for (int b = 0; b < RENDER_BLOCKS; b++) {
+        if (b > 0) send_events(api, inst, script, &next, b);
+        g_clock_ns = 1000000000LL + frame_ns((int64_t)b * BLOCK_FRAMES);
+        api->render_block(inst, &g_pcm[b * BLOCK_FRAMES * 2], BLOCK_FRAMES);
+    }
+    api->destroy_instance(inst);
+
+    snprintf(fp->key, sizeof(fp->key), "%02d %s %s %s", preset, g_chip_names[chip],
+             g_alloc_names[alloc], script->name);
+    fingerprint(g_pcm, RENDER_BLOCKS * BLOCK_FRAMES, fp);
+    return 0;
+}
+
+/* =====================================================================
+ * Reference files
+ *
+ * One line per render:
+ *   <preset> <chip> <alloc> <script> <hash> <rms dB> <band dB> x NUM_BANDS
+ * ===================================================================== */
+
+static void ref_path(char *path, size_t len, const char *dir, int chip) {
+    snprintf(path, len, "%s/%s.txt", dir, g_chip_files[chip]);
+}
+
+/* Returns the number of references read, or -1 if there is no file */
+static int read_refs(const char *path, fingerprint_t *refs, int max) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[512];
+    int n = 0;
+    while (n < max && fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        fingerprint_t *fp = &refs[n];
+        int preset;
+        char chip[8], alloc[8], script[16];
+        unsigned long long hash;
+        int pos = 0;
+        if (sscanf(line, "%d %7s %7s %15s %llx %lf%n", &preset, chip, alloc, script,
+                   &hash, &fp->rms_db, &pos) != 6) continue;
+        const char *p = line + pos;
+        int b = 0;
+        for (; b < NUM_BANDS; b++) {
+            char *end;
+            fp->bands[b] = strtod(p, &end);
+            if (end == p) break;
+            p = end;
+        }
+        if (b < NUM_BANDS) continue;
+        snprintf(fp->key, sizeof(fp->key), "%02d %s %s %s", preset, chip, alloc, script);
+        fp->hash = hash;
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+static void write_ref(FILE *f, const fingerprint_t *fp) {
+    fprintf(f, "%s %016llx %.2f", fp->key, (unsigned long long)fp->hash, fp->rms_db);
+    for (int b = 0; b < NUM_BANDS; b++) fprintf(f, " %.2f", fp->bands[b]);
+    fputc('\n', f);
+}
+
+static const fingerprint_t *find_ref(const fingerprint_t *refs, int n, const char *key) {
+    for (int i = 0; i < n; i++) {
+        if (strcmp(refs[i].key, key) == 0) return &refs[i];
+    }
+    return NULL;
+}
+
+/* Largest level difference, ignoring bands quiet in both renders */
+static double max_level_delta(const fingerprint_t *a, const fingerprint_t *b) {
+    double worst = fabs(a->rms_db - b->rms_db);
+    for (int i = 0; i < NUM_BANDS; i++) {
+        if (a->bands[i] < BAND_FLOOR_DB && b->bands[i] < BAND_FLOOR_DB) continue;
+        double d = fabs(a->bands[i] - b->bands[i]);
+        if (d > worst) worst = d;
+    }
+    return worst;
+}
+
+/* =====================================================================
+ * Main
+ * ===================================================================== */
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Usage: %s [-u] [-t DB] [-c nes|gb] [-r DIR] [dsp.so]\n"
+        "  -u        record references instead of checking\n"
+        "  -t DB     tolerance mode: RMS and band levels within DB\n"
+        "  -c CHIP   only this chip\n"
+        "  -r DIR    reference directory (default tools/golden)\n", prog);
+}
+
+int main(int argc, char **argv) {
+    const char *so_path = "build/host/dsp.so";
+    const char *ref_dir = "tools/golden";
+    const char *module_dir = "src";
+    int update = 0;
+    int only_chip = -1;
+    double tolerance = -1.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-u") == 0) {
+            update = 1;
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "nes") == 0) only_chip = 0;
+            else if (strcmp(argv[i], "gb") == 0) only_chip = 1;
+            else { usage(argv[0]); return 1; }
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            ref_dir = argv[++i];
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            so_path = argv[i];
+        }
+    }
+
+    void *handle = dlopen(so_path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        fprintf(stderr, "dlopen failed: %s\n", dlerror());
+        return 1;
+    }
+    move_plugin_init_v2_fn init = (move_plugin_init_v2_fn)dlsym(handle, "move_plugin_init_v2");
+    if (!init) {
+        fprintf(stderr, "move_plugin_init_v2 not found\n");
+        return 1;
+    }
+    static host_api_v1_t host;
+    host.api_version = 1;
+    host.sample_rate = SAMPLE_RATE;
+    host.frames_per_block = BLOCK_FRAMES;
+    const plugin_api_v2_t *api = init(&host);
+
+    void *probe = api->create_instance(module_dir, NULL);
+    if (!probe) {
+        fprintf(stderr, "create_instance failed\n");
+        return 1;
+    }
+    char buf[16];
+    int preset_count = 0;
+    if (api->get_param(probe, "preset_count", buf, sizeof(buf)) > 0) preset_count = atoi(buf);
+    api->destroy_instance(probe);
+
+    static fingerprint_t refs[MAX_REFS];
+    int failures = 0;
+    int checked = 0;
+    int skipped = 0;
+    int exact = 0;
+    double worst = 0.0;
+
+    for (int chip = 0; chip < NUM_CHIPS; chip++) {
+        if (only_chip >= 0 && chip != only_chip) continue;
+
+        char path[512];
+        ref_path(path, sizeof(path), ref_dir, chip);
+        char tmp_path[520];
+        snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+        FILE *out = NULL;
+        int ref_count = 0;
+        int audible = 0;
+        if (update) {
+            out = fopen(tmp_path, "w");
+            if (!out) {
+                fprintf(stderr, "Cannot write %s\n", tmp_path);
+                return 1;
+            }
+            fprintf(out, "# Golden render fingerprints, %s (tools/golden_render.cpp -u)\n"
+                         "# preset chip alloc script hash rms_db band_db x %d\n",
+                    g_chip_names[chip], NUM_BANDS);
+        } else {
+            ref_count = read_refs(path, refs, MAX_REFS);
+            if (ref_count < 0) {
+                printf("SKIP: %s: no references in %s (record with -u -c %s)\n",
+                       g_chip_names[chip], path, g_chip_files[chip]);
+                skipped++;
+                continue;
+            }
+        }
+
+        int chip_failures = 0;
+        for (int p = 0; p < preset_count; p++) {
+            for (int a = 0; a < NUM_ALLOC; a++) {
+                for (int s = 0; s < NUM_SCRIPTS; s++) {
+                    fingerprint_t fp;
+                    if (render(api, module_dir, p, chip, a, &g_scripts[s], &fp) != 0) {
+                        fprintf(stderr, "create_instance failed\n");
+                        return 1;
+                    }
+                    checked++;
+                    if (out) {
+                        write_ref(out, &fp);
+                        if (fp.rms_db > SILENCE_DB) audible = 1;
+                        continue;
+                    }
+
+                    const fingerprint_t *ref = find_ref(refs, ref_count, fp.key);
+                    if (!ref) {
+                        printf("FAIL: %s: no reference\n", fp.key);
+                        chip_failures++;
+                        continue;
+                    }
+                    double delta = max_level_delta(&fp, ref);
+                    if (fp.hash == ref->hash) exact++;
+                    if (delta > worst) worst = delta;
+                    int ok = tolerance >= 0.0 ? delta <= tolerance : fp.hash == ref->hash;
+                    if (!ok) {
+                        if (chip_failures < 20) {
+                            printf("FAIL: %s: hash %016llx (want %016llx), level delta %.2f dB\n",
+                                   fp.key, (unsigned long long)fp.hash,
+                                   (unsigned long long)ref->hash, delta);
+                        }
+                        chip_failures++;
+                    }
+                }
+            }
+        }
+
+        if (out) {
+            fclose(out);
+            if (!audible) {
+                /* Nothing to regression-check against */
+                remove(tmp_path);
+                printf("FAIL: %s: every render is silent, not recorded (is the chip library a stub?)\n",
+                       g_chip_names[chip]);
+                failures++;
+                continue;
+            }
+            if (rename(tmp_path, path) != 0) {
+                fprintf(stderr, "Cannot write %s\n", path);
+                return 1;
+            }
+            printf("%s: wrote %s\n", g_chip_names[chip], path);
+        }
+        failures += chip_failures;
+    }
+
+    dlclose(handle);
+    if (update) {
+        printf("%d renders recorded\n", checked);
+    } else if (tolerance >= 0.0) {
+        printf("%d renders checked (tolerance mode: %d bit-exact, largest level delta %.3f dB)\n",
+               checked, exact, worst);
+    } else {
+        printf("%d renders checked (bit-exact mode)\n", checked);
+    }
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    if (skipped) {
+        printf("OK, %d chip(s) SKIPPED for lack of references\n", skipped);
+    } else {
+        printf("OK\n");
+    }
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * GB loop cache check (host-native)
+ *
+ * Once the wave channel has held the same pitch, volume and wave RAM for a
+ * while, Gb_Wave::run adds whole cycles captured earlier (Gb_Loop) instead
+ * of synthesizing each transition. This runs the oscillator with and without
+ * a loop cache on the same register sequence, and checks:
+ *   - wave position, amplitude and delay match after every frame, so the
+ *     cache never changes what the channel does next
+ *   - the output stays close to the uncached output; cycles are placed to
+ *     within 1/64 sample, about the rounding Blip_Synth already gives each
+ *     transition, so the error grows with pitch
+ *   - the cache is used for cycles up to Gb_Loop::max_span samples, not for
+ *     longer ones
+ *   - register changes mid-note (wave RAM, volume) are picked up
+ *   - after the channel is silenced, both settle to the same DC level
+ *
+ * Build and run with ./scripts/check.sh
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Gb_Apu.h"   /* gb_time_t, then Gb_Oscs.h */
+
+#define SAMPLE_RATE   44100
+#define GB_CLOCK      4194304
+#define BLOCK_FRAMES  128
+#define FRAME_CLOCKS  ((long)GB_CLOCK * BLOCK_FRAMES / SAMPLE_RATE)
+#define SYNTH_VOLUME  0.15
+#define SETTLE_FRAMES 64     /* well past the Blip_Buffer bass filter's decay */
+
+static int g_failures = 0;
+
+static void check(bool ok, const char *what, const char *config) {
+    if (!ok) {
+        printf("FAIL: %s (%s)\n", what, config);
+        g_failures++;
+    }
+}
+
+static Gb_Wave::Synth g_wave_synth;
+
+/* A wave channel with its own buffer and optional cache */
+struct Voice {
+    Blip_Buffer buf;
+    Gb_Wave wave;
+    Gb_Loop loop;
+};
+
+static void voice_init(Voice &v, bool cached) {
+    v.buf.clock_rate(GB_CLOCK);
+    v.buf.set_sample_rate(SAMPLE_RATE, 100);
+    v.buf.clear();
+    v.wave.outputs[1] = v.wave.outputs[2] = v.wave.outputs[3] = &v.buf;
+    v.wave.reset();
+    v.wave.global_volume = 7;
+    v.wave.synth = &g_wave_synth;
+    v.loop.invalidate();
+    v.wave.loop = cached ? &v.loop : NULL;
+}
+
+/*
+ * One frame, run in 'splits' pieces as Gb_Apu::run_until does around
+ * register writes; returns samples read into out
+ */
+static long voice_frame(Voice &v, int splits, blip_sample_t *out) {
+    gb_time_t t = 0;
+    for (int i = 1; i <= splits; i++) {
+        gb_time_t end = (gb_time_t)((long long)FRAME_CLOCKS * i / splits);
+        v.wave.run(t, end);
+        t = end;
+    }
+    v.buf.end_frame(FRAME_CLOCKS);
+    return v.buf.read_samples(out, v.buf.samples_avail());
+}
+
+/* Wave RAM, invalidating the cache as Gb_Apu::write_register does */
+static void fill_wave(Voice &v, int shape) {
+    for (int i = 0; i < Gb_Wave::wave_size; i++) {
+        switch (shape) {
+        case 0: v.wave.wave[i] = i < 16 ? 15 : 0; break;              /* square */
+        case 1: v.wave.wave[i] = i < 16 ? i : 31 - i; break;          /* triangle */
+        default: v.wave.wave[i] = (i * 7 + (i >> 2) * 5) & 15; break; /* busy */
+        }
+    }
+    v.loop.invalidate();
+}
+
+static void voice_note(Voice &v, int frequency, int shape) {
+    fill_wave(v, shape);
+    v.wave.write_register(0, 0x80);
+    v.wave.write_register(2, 0x20);
+    v.wave.write_register(3, frequency & 0xFF);
+    v.wave.write_register(4, 0x80 | (frequency >> 8));
+}
+
+/* Mid-note changes: first the wave shape alone, then the level */
+static void voice_change(Voice &v, int step, int shape) {
+    if (step == 0) fill_wave(v, shape == 2 ? 1 : 2);
+    else v.wave.write_register(2, 0x40);
+}
+
+/*
+ * Hold a note for 'frames' frames with register changes a third and two
+ * thirds of the way in, then
+ * silence the channel and let both settle. 'max_db' bounds the error;
+ * 'cacheable' says whether the cycle fits the cache.
+ */
+static void run_case(int frequency, int shape, int frames, bool cacheable, double max_db) {
+    static Voice cached, plain;
+    voice_init(cached, true);
+    voice_init(plain, false);
+    Voice *voices[2] = {&cached, &plain};
+    for (int i = 0; i < 2; i++) voice_note(*voices[i], frequency, shape);
+
+    char config[64];
+    snprintf(config, sizeof(config), "wave period %d", cached.wave.period);
+
+    double signal = 0, error = 0;
+    int used = 0;
+    bool state_ok = true;
+    static blip_sample_t a[BLOCK_FRAMES * 2], b[BLOCK_FRAMES * 2];
+
+    for (int f = 0; f < frames + SETTLE_FRAMES; f++) {
+        if (f == frames / 3 || f == frames * 2 / 3) {
+            for (int i = 0; i < 2; i++) voice_change(*voices[i], f == frames / 3 ? 0 : 1, shape);
+        }
+        if (f == frames) {
+            cached.wave.enabled = false;
+            plain.wave.enabled = false;
+        }
+        /* Mostly whole frames, as with no MIDI events; cycles that cross a
+         * split aren't cached */
+        int splits = (f % 4) ? 1 : 1 + (f * 7) % 13;
+        long na = voice_frame(cached, splits, a);
+        long nb = voice_frame(plain, splits, b);
+        if (na != nb) state_ok = false;
+        if (cached.wave.wave_pos != plain.wave.wave_pos || cached.wave.last_amp != plain.wave.last_amp ||
+            cached.wave.delay != plain.wave.delay) {
+            state_ok = false;
+        }
+        for (long i = 0; i < na && i < nb && f < frames; i++) {
+            double e = (double)a[i] - b[i];
+            signal += (double)b[i] * b[i];
+            error += e * e;
+        }
+        for (int k = 0; k < Gb_Loop::phase_count; k++) {
+            if (cached.loop.captured(k)) used++;
+        }
+    }
+    check(state_ok, "wave position, amplitude and delay match the uncached run", config);
+
+    double db = 10 * log10((error + 1e-9) / (signal + 1e-9));
+    printf("  %-18s %-10s error %6.1f dB\n", config, used ? "cached" : "not cached", db);
+    check(db < max_db, "error within bounds", config);
+    check((used != 0) == cacheable, cacheable ? "cache used" : "cache not used", config);
+
+    /* Silenced: both outputs decay identically from here */
+    int diff = abs((int)a[BLOCK_FRAMES - 1] - (int)b[BLOCK_FRAMES - 1]);
+    check(diff <= 1, "cached and uncached settle to the same level", config);
+}
+
+int main(void) {
+    g_wave_synth.volume(SYNTH_VOLUME);
+
+    /* Wave period (2048 - f) * 2, cycle 32 periods: 8 (16.4 kHz), 32,
+     * 148 (A4), 250 (C4); 512 (C3) is past max_span. Square, triangle and
+     * busy waves. */
+    run_case(2044, 0, 400, true, -19);
+    run_case(2032, 1, 400, true, -26);
+    run_case(1974, 2, 400, true, -38);
+    run_case(1923, 1, 400, true, -44);
+    run_case(1792, 2, 400, false, -150);
+
+    if (g_failures) {
+        printf("loop_check: %d failure(s)\n", g_failures);
+        return 1;
+    }
+    printf("loop_check: OK\n");
+    return 0;
+}
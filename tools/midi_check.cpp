@@ -0,0 +1,207 @@
+/*
+ * MIDI timing and mod wheel check (host-native)
+ *
+ * Loads a natively built dsp.so, feeds it MIDI at known times and checks
+ * the rendered output:
+ *   - an event sent from another thread k samples after a render started
+ *     starts k samples later in the next block than one sent at 0
+ *   - an event sent from the rendering thread between renders starts at
+ *     offset 0, however long after the last render it arrives
+ *   - the mod wheel's vibrato depth survives changes to other parameters
+ *
+ * Like golden_render, this replaces clock_gettime(CLOCK_MONOTONIC) with a
+ * virtual clock (it is linked with -rdynamic), so the times are exact.
+ *
+ * Usage: midi_check [dsp.so]
+ *
+ * Build and run with ./scripts/check.sh
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <pthread.h>
+
+#define PLUGIN_API_VIRTUAL_CLOCK
+#include "plugin_api.h"
+
+#define SAMPLE_RATE   44100
+#define BLOCK_FRAMES  128
+#define GB_PRESET     "16"   /* GB Lead: instant attack */
+#define ONSET_LEVEL   1024   /* well above the idle output */
+#define VIBRATO_PRESET "22"  /* GB Vibrato */
+#define WHEEL_BLOCKS  64
+
+static int g_failures = 0;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        g_failures++;
+    }
+}
+
+/* =====================================================================
+ * Virtual clock (plugin_api.h)
+ * ===================================================================== */
+
+/* Time of a frame, rounded up so the plugin's floor(ns * rate / 1e9) gives
+ * the frame back exactly */
+static int64_t frame_ns(int64_t frame) {
+    return 1000000000LL + (frame * 1000000000LL + SAMPLE_RATE - 1) / SAMPLE_RATE;
+}
+
+/* =====================================================================
+ * Rendering
+ * ===================================================================== */
+
+typedef struct {
+    const plugin_api_v2_t *api;
+    void *inst;
+} note_args_t;
+
+static void *note_on(void *arg) {
+    const note_args_t *a = (const note_args_t *)arg;
+    static const uint8_t msg[3] = {0x90, 60, 127};
+    a->api->on_midi(a->inst, msg, 3, 0);
+    return NULL;
+}
+
+/*
+ * Render a silent block, send a note-on 'delay' samples after it started
+ * (from a second thread, or from this one), render the next block and
+ * return the first sample of it above ONSET_LEVEL, or -1
+ */
+static int note_onset(const plugin_api_v2_t *api, int delay, bool from_render_thread) {
+    void *inst = api->create_instance("src", NULL);
+    if (!inst) return -1;
+    api->set_param(inst, "chip", "GB");
+    api->set_param(inst, "preset", GB_PRESET);
+
+    static int16_t pcm[BLOCK_FRAMES * 2];
+    g_clock_ns = frame_ns(0);
+    api->render_block(inst, pcm, BLOCK_FRAMES);
+
+    g_clock_ns = frame_ns(delay);
+    note_args_t args = {api, inst};
+    pthread_t thread;
+    if (from_render_thread) {
+        note_on(&args);
+    } else if (pthread_create(&thread, NULL, note_on, &args) == 0) {
+        pthread_join(thread, NULL);
+    } else {
+        /* Sending from here would land at offset 0 and prove nothing */
+        printf("FAIL: cannot start a thread to send the note from\n");
+        exit(1);
+    }
+
+    g_clock_ns = frame_ns(BLOCK_FRAMES);
+    api->render_block(inst, pcm, BLOCK_FRAMES);
+    api->destroy_instance(inst);
+
+    for (int i = 0; i < BLOCK_FRAMES; i++) {
+        if (abs(pcm[i * 2]) > ONSET_LEVEL) return i;
+    }
+    return -1;
+}
+
+/*
+ * Hold a note with the mod wheel at 'wheel' (< 0: untouched), optionally
+ * setting vibrato_rate to its own value halfway; returns a hash of the PCM
+ */
+static uint64_t wheel_render(const plugin_api_v2_t *api, int wheel, bool touch_knob) {
+    void *inst = api->create_instance("src", NULL);
+    if (!inst) return 0;
+    api->set_param(inst, "chip", "GB");
+    api->set_param(inst, "preset", VIBRATO_PRESET);
+
+    static const uint8_t note[3] = {0x90, 69, 127};
+    api->on_midi(inst, note, 3, 0);
+    if (wheel >= 0) {
+        uint8_t cc[3] = {0xB0, 1, (uint8_t)wheel};
+        api->on_midi(inst, cc, 3, 0);
+    }
+
+    uint64_t h = 14695981039346656037ULL;
+    static int16_t pcm[BLOCK_FRAMES * 2];
+    for (int b = 0; b < WHEEL_BLOCKS; b++) {
+        if (touch_knob && b == WHEEL_BLOCKS / 2) {
+            char rate[32];
+            if (api->get_param(inst, "vibrato_rate", rate, sizeof(rate)) > 0) {
+                api->set_param(inst, "vibrato_rate", rate);
+            }
+        }
+        g_clock_ns = frame_ns((int64_t)b * BLOCK_FRAMES);
+        api->render_block(inst, pcm, BLOCK_FRAMES);
+        for (int i = 0; i < BLOCK_FRAMES * 2; i++) {
+            h = (h ^ (uint16_t)pcm[i]) * 1099511628211ULL;
+        }
+    }
+    api->destroy_instance(inst);
+    return h;
+}
+
+int main(int argc, char **argv) {
+    const char *so_path = argc > 1 ? argv[1] : "build/host/dsp.so";
+
+    void *handle = dlopen(so_path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        fprintf(stderr, "dlopen failed: %s\n", dlerror());
+        return 1;
+    }
+    move_plugin_init_v2_fn init = (move_plugin_init_v2_fn)dlsym(handle, "move_plugin_init_v2");
+    if (!init) {
+        fprintf(stderr, "move_plugin_init_v2 not found\n");
+        return 1;
+    }
+    static host_api_v1_t host;
+    host.api_version = 1;
+    host.sample_rate = SAMPLE_RATE;
+    host.frames_per_block = BLOCK_FRAMES;
+    const plugin_api_v2_t *api = init(&host);
+
+    int base = note_onset(api, 0, false);
+    printf("  note sent at 0: starts at sample %d\n", base);
+    /* Synth and Blip_Buffer latency, the same for every offset below */
+    if (base < 0 || base + 100 >= BLOCK_FRAMES) {
+        printf("FAIL: no onset early enough in the block for the note sent at 0\n");
+        return 1;
+    }
+
+    /* Another thread: the event lands 'delay' samples into the block */
+    static const int delays[] = {1, 17, 64, 100};
+    for (unsigned i = 0; i < sizeof(delays) / sizeof(delays[0]); i++) {
+        int onset = note_onset(api, delays[i], false);
+        char what[96];
+        snprintf(what, sizeof(what), "note sent %d samples in starts at %d, expected %d",
+                 delays[i], onset, base + delays[i]);
+        check(onset == base + delays[i], what);
+    }
+
+    /* The rendering thread: always at 0 */
+    static const int late[] = {1, 64, 100};
+    for (unsigned i = 0; i < sizeof(late) / sizeof(late[0]); i++) {
+        int onset = note_onset(api, late[i], true);
+        char what[96];
+        snprintf(what, sizeof(what), "note sent from the render thread %d samples in starts at %d, expected %d",
+                 late[i], onset, base);
+        check(onset == base, what);
+    }
+
+    /* Mod wheel: changes the sound, and other knobs don't undo it */
+    uint64_t plain = wheel_render(api, -1, false);
+    uint64_t wheel = wheel_render(api, 127, false);
+    uint64_t wheel_knob = wheel_render(api, 127, true);
+    check(wheel != plain, "mod wheel changes the vibrato");
+    check(wheel_knob == wheel, "mod wheel depth kept after another parameter is set");
+
+    if (g_failures) {
+        printf("midi_check: %d failure(s)\n", g_failures);
+        return 1;
+    }
+    printf("midi_check: OK\n");
+    return 0;
+}
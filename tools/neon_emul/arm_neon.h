@@ -0,0 +1,99 @@
+/*
+ * arm_neon.h - Scalar stand-ins for the NEON intrinsics used by the
+ * Stereo_Buffer gain readout (Multi_Buffer.cpp)
+ *
+ * Lets tools/readout_check.cpp build the NEON path on any host and compare
+ * it against the scalar one. Only the intrinsics that code uses are here,
+ * with the same lane semantics as the real ones.
+ */
+
+#ifndef NEON_EMUL_ARM_NEON_H
+#define NEON_EMUL_ARM_NEON_H
+
+#include <stdint.h>
+
+typedef struct { int16_t v[4]; } int16x4_t;
+typedef struct { int16_t v[8]; } int16x8_t;
+typedef struct { int32_t v[4]; } int32x4_t;
+typedef struct { int16x8_t val[2]; } int16x8x2_t;
+
+static inline int16_t neon_emul_sat16(int32_t x) {
+    return x > 32767 ? 32767 : x < -32768 ? -32768 : (int16_t)x;
+}
+
+static inline int16x4_t vdup_n_s16(int16_t x) {
+    int16x4_t r;
+    for (int i = 0; i < 4; i++) r.v[i] = x;
+    return r;
+}
+
+static inline int16x8_t vdupq_n_s16(int16_t x) {
+    int16x8_t r;
+    for (int i = 0; i < 8; i++) r.v[i] = x;
+    return r;
+}
+
+static inline int32x4_t vld1q_s32(const int32_t *p) {
+    int32x4_t r;
+    for (int i = 0; i < 4; i++) r.v[i] = p[i];
+    return r;
+}
+
+static inline void vst1q_s16(int16_t *p, int16x8_t a) {
+    for (int i = 0; i < 8; i++) p[i] = a.v[i];
+}
+
+/* Interleaving store: p[2i] = a.val[0][i], p[2i+1] = a.val[1][i] */
+static inline void vst2q_s16(int16_t *p, int16x8x2_t a) {
+    for (int i = 0; i < 8; i++) {
+        p[i * 2] = a.val[0].v[i];
+        p[i * 2 + 1] = a.val[1].v[i];
+    }
+}
+
+static inline int16x4_t vqmovn_s32(int32x4_t a) {
+    int16x4_t r;
+    for (int i = 0; i < 4; i++) r.v[i] = neon_emul_sat16(a.v[i]);
+    return r;
+}
+
+static inline int32x4_t vmull_s16(int16x4_t a, int16x4_t b) {
+    int32x4_t r;
+    for (int i = 0; i < 4; i++) r.v[i] = (int32_t)a.v[i] * b.v[i];
+    return r;
+}
+
+static inline int16x4_t vget_low_s16(int16x8_t a) {
+    int16x4_t r;
+    for (int i = 0; i < 4; i++) r.v[i] = a.v[i];
+    return r;
+}
+
+static inline int16x4_t vget_high_s16(int16x8_t a) {
+    int16x4_t r;
+    for (int i = 0; i < 4; i++) r.v[i] = a.v[i + 4];
+    return r;
+}
+
+static inline int16x8_t vcombine_s16(int16x4_t lo, int16x4_t hi) {
+    int16x8_t r;
+    for (int i = 0; i < 4; i++) {
+        r.v[i] = lo.v[i];
+        r.v[i + 4] = hi.v[i];
+    }
+    return r;
+}
+
+static inline int16x8_t vminq_s16(int16x8_t a, int16x8_t b) {
+    int16x8_t r;
+    for (int i = 0; i < 8; i++) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+    return r;
+}
+
+static inline int16x8_t vmaxq_s16(int16x8_t a, int16x8_t b) {
+    int16x8_t r;
+    for (int i = 0; i < 8; i++) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+    return r;
+}
+
+#endif /* NEON_EMUL_ARM_NEON_H */
@@ -0,0 +1,282 @@
+/*
+ * GB noise fast path check (host-native)
+ *
+ * At high noise pitches Gb_Noise::run averages the LFSR over each half
+ * sample and adds one band-limited step per half sample, instead of one per
+ * transition. This runs it next to a copy of the per-transition loop, on the
+ * same register sequence, and checks:
+ *   - the LFSR state, amplitude and delay match after every frame, so the
+ *     two paths can hand over to each other at any time
+ *   - the output stays close to the per-transition loop's: total error, error
+ *     below 1 kHz, and levels in bands up to 17 kHz. The per-transition loop
+ *     places each step to within 1/32 sample, which at period 8 is already
+ *     about 10 dB of error against itself delayed by one clock, so the total
+ *     error bound cannot be much tighter than that.
+ *   - after the channel is silenced, both settle to the same DC level
+ *
+ * Build and run with ./scripts/check.sh
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Gb_Apu.h"   /* gb_time_t, then Gb_Oscs.h */
+
+#define SAMPLE_RATE   44100
+#define GB_CLOCK      4194304
+#define BLOCK_FRAMES  128
+#define FRAME_CLOCKS  ((long)GB_CLOCK * BLOCK_FRAMES / SAMPLE_RATE)
+#define SYNTH_VOLUME  0.15
+#define SETTLE_FRAMES 64     /* well past the Blip_Buffer bass filter's decay */
+#define MAX_FRAMES    400    /* longest note, in frames */
+#define FFT_SIZE      4096
+#define MAX_DB_TOTAL  -10.0  /* total error */
+#define MAX_DB_LOW    -25.0  /* error below 1 kHz */
+#define MAX_DB_BAND   1.0    /* level difference per band */
+
+static int g_failures = 0;
+
+static void check(bool ok, const char *what, const char *config) {
+    if (!ok) {
+        printf("FAIL: %s (%s)\n", what, config);
+        g_failures++;
+    }
+}
+
+/* Gb_Noise::run with the per-transition loop only, as before the fast path */
+static void run_exact(Gb_Noise &n, gb_time_t time, gb_time_t end_time) {
+    if (!n.enabled || (!n.length && n.length_enabled) || !n.volume) {
+        if (n.last_amp) {
+            n.synth->offset(time, -n.last_amp, n.output);
+            n.last_amp = 0;
+        }
+        n.delay = 0;
+        return;
+    }
+    int amp = n.bits & 1 ? -n.volume : n.volume;
+    amp *= n.global_volume;
+    if (amp != n.last_amp) {
+        n.synth->offset(time, amp - n.last_amp, n.output);
+        n.last_amp = amp;
+    }
+    time += n.delay;
+    if (time < end_time) {
+        blip_resampled_time_t resampled_period = n.output->resampled_duration(n.period);
+        blip_resampled_time_t resampled_time = n.output->resampled_time(time);
+        const unsigned mask = ~(1u << n.tap);
+        unsigned bits = n.bits;
+        amp *= 2;
+        do {
+            unsigned feedback = bits;
+            bits >>= 1;
+            feedback = 1 & (feedback ^ bits);
+            time += n.period;
+            bits = (feedback << n.tap) | (bits & mask);
+            if (feedback) {
+                amp = -amp;
+                n.synth->offset_resampled(resampled_time, amp, n.output);
+            }
+            resampled_time += resampled_period;
+        } while (time < end_time);
+        n.bits = bits;
+        n.last_amp = amp >> 1;
+    }
+    n.delay = time - end_time;
+}
+
+struct Voice {
+    Blip_Buffer buf;
+    Gb_Noise noise;
+};
+
+static void voice_init(Voice &v, const Gb_Noise::Synth *synth) {
+    v.buf.clock_rate(GB_CLOCK);
+    v.buf.set_sample_rate(SAMPLE_RATE, 100);
+    v.noise.outputs[1] = v.noise.outputs[2] = v.noise.outputs[3] = &v.buf;
+    v.noise.reset();
+    v.noise.synth = synth;
+}
+
+/*
+ * One frame, run in 'splits' pieces as Gb_Apu::run_until does around
+ * register writes; returns samples read into out
+ */
+static long voice_frame(Voice &v, bool exact, int splits, blip_sample_t *out) {
+    gb_time_t t = 0;
+    for (int i = 1; i <= splits; i++) {
+        gb_time_t end = (gb_time_t)((long long)FRAME_CLOCKS * i / splits);
+        if (exact) run_exact(v.noise, t, end);
+        else v.noise.run(t, end);
+        t = end;
+    }
+    v.buf.end_frame(FRAME_CLOCKS);
+    return v.buf.read_samples(out, v.buf.samples_avail());
+}
+
+/* Four one-pole stages at 1 kHz, enough to keep the aliased top octaves out */
+struct Lowpass {
+    double z[4];
+    double run(double x) {
+        const double k = 1.0 - exp(-2.0 * M_PI * 1000.0 / SAMPLE_RATE);
+        for (int i = 0; i < 4; i++) x = z[i] += k * (x - z[i]);
+        return x;
+    }
+};
+
+/* In-place radix-2 FFT */
+static void fft(double *re, double *im, int n) {
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j |= bit;
+        if (i < j) {
+            double t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        double a = -2.0 * M_PI / len;
+        for (int i = 0; i < n; i += len) {
+            for (int k = 0; k < len / 2; k++) {
+                double wr = cos(a * k), wi = sin(a * k);
+                double *xr = &re[i + k], *xi = &im[i + k];
+                double *yr = &re[i + k + len / 2], *yi = &im[i + k + len / 2];
+                double tr = *yr * wr - *yi * wi;
+                double ti = *yr * wi + *yi * wr;
+                *yr = *xr - tr;
+                *yi = *xi - ti;
+                *xr += tr;
+                *xi += ti;
+            }
+        }
+    }
+}
+
+/* Bands compared by level. Below 2 kHz the 7-bit noise at these periods has
+ * no content of its own, only the per-transition loop's timing error. */
+static const double g_band_edges[] = {2000, 5000, 10000, 14000, 17000};
+#define NUM_BANDS ((int)(sizeof(g_band_edges) / sizeof(g_band_edges[0])) - 1)
+
+/* Power in each band: Hann-windowed spectra with 50% overlap, summed */
+static void band_power(const double *x, long n, double *power) {
+    static double re[FFT_SIZE], im[FFT_SIZE];
+    for (int b = 0; b < NUM_BANDS; b++) power[b] = 0;
+    for (long start = 0; start + FFT_SIZE <= n; start += FFT_SIZE / 2) {
+        for (int i = 0; i < FFT_SIZE; i++) {
+            re[i] = x[start + i] * (0.5 - 0.5 * cos(2.0 * M_PI * i / FFT_SIZE));
+            im[i] = 0.0;
+        }
+        fft(re, im, FFT_SIZE);
+        for (int k = 1; k < FFT_SIZE / 2; k++) {
+            double f = (double)k * SAMPLE_RATE / FFT_SIZE;
+            for (int b = 0; b < NUM_BANDS; b++) {
+                if (f >= g_band_edges[b] && f < g_band_edges[b + 1]) power[b] += re[k] * re[k] + im[k] * im[k];
+            }
+        }
+    }
+}
+
+/*
+ * Render 'frames' frames of noise with the given NR43 value, switching
+ * NR43 to 'next_nr43' halfway (so both paths hand over mid-note), then
+ * silence the channel and let both settle.
+ */
+static void run_case(const Gb_Noise::Synth *synth, int nr43, int next_nr43, int frames) {
+    static Voice fast, exact;
+    voice_init(fast, synth);
+    voice_init(exact, synth);
+    Voice *voices[2] = {&fast, &exact};
+
+    char config[64];
+    snprintf(config, sizeof(config), "NR43 %02X -> %02X", nr43, next_nr43);
+
+    for (int i = 0; i < 2; i++) {
+        Gb_Noise &n = voices[i]->noise;
+        n.global_volume = 7;
+        n.write_register(2, 0xF0);
+        n.write_register(3, nr43);
+        n.write_register(4, 0x80);
+        n.enabled = true;
+    }
+
+    double signal = 0, error = 0, low_error = 0;
+    Lowpass lp_fast = {{0}}, lp_exact = {{0}};
+    bool state_ok = true;
+    static blip_sample_t a[BLOCK_FRAMES * 2], b[BLOCK_FRAMES * 2];
+    static double held_fast[MAX_FRAMES * BLOCK_FRAMES * 2], held_exact[MAX_FRAMES * BLOCK_FRAMES * 2];
+    long held = 0;
+
+    for (int f = 0; f < frames + SETTLE_FRAMES; f++) {
+        if (f == frames / 2) {
+            fast.noise.write_register(3, next_nr43);
+            exact.noise.write_register(3, next_nr43);
+        }
+        if (f == frames) {
+            fast.noise.enabled = false;
+            exact.noise.enabled = false;
+        }
+        int splits = 1 + (f * 7) % 13;
+        long na = voice_frame(fast, false, splits, a);
+        long nb = voice_frame(exact, true, splits, b);
+        if (na != nb) state_ok = false;
+        if (fast.noise.bits != exact.noise.bits || fast.noise.last_amp != exact.noise.last_amp ||
+            fast.noise.delay != exact.noise.delay) {
+            state_ok = false;
+        }
+        for (long i = 0; i < na && i < nb && f < frames; i++) {
+            double e = (double)a[i] - b[i];
+            signal += (double)b[i] * b[i];
+            error += e * e;
+            double lf = lp_fast.run(a[i]), le = lp_exact.run(b[i]);
+            low_error += (lf - le) * (lf - le);
+            held_fast[held] = a[i];
+            held_exact[held++] = b[i];
+        }
+    }
+    check(state_ok, "LFSR state, amplitude and delay match the exact path", config);
+
+    double total_db = 10 * log10((error + 1e-9) / (signal + 1e-9));
+    double low_db = 10 * log10((low_error + 1e-9) / (signal + 1e-9));
+    printf("  %-18s error %6.1f dB, below 1 kHz %6.1f dB, levels 2-17 kHz", config, total_db, low_db);
+    check(total_db < MAX_DB_TOTAL, "total error within bounds", config);
+    check(low_db < MAX_DB_LOW, "error below 1 kHz within bounds", config);
+
+    double p_fast[NUM_BANDS], p_exact[NUM_BANDS];
+    band_power(held_fast, held, p_fast);
+    band_power(held_exact, held, p_exact);
+    bool bands_ok = true;
+    for (int i = 0; i < NUM_BANDS; i++) {
+        double d = 10 * log10((p_fast[i] + 1e-9) / (p_exact[i] + 1e-9));
+        printf(" %+.1f", d);
+        if (fabs(d) > MAX_DB_BAND) bands_ok = false;
+    }
+    printf(" dB\n");
+    check(bands_ok, "band levels within bounds", config);
+
+    /* Silenced: both outputs decay identically from here */
+    int diff = abs((int)a[BLOCK_FRAMES - 1] - (int)b[BLOCK_FRAMES - 1]);
+    check(diff <= 1, "both paths settle to the same level", config);
+}
+
+int main(void) {
+    static Gb_Noise::Synth synth;
+    synth.volume(SYNTH_VOLUME);
+
+    /* Fast path both halves: periods 8 and 16, 15- and 7-bit */
+    run_case(&synth, 0x00, 0x10, MAX_FRAMES);
+    run_case(&synth, 0x08, 0x18, MAX_FRAMES);
+    run_case(&synth, 0x01, 0x00, MAX_FRAMES);
+    /* Handover between the paths in both directions */
+    run_case(&synth, 0x00, 0x50, MAX_FRAMES);
+    run_case(&synth, 0x58, 0x08, MAX_FRAMES);
+    run_case(&synth, 0x20, 0x10, MAX_FRAMES);
+
+    if (g_failures) {
+        printf("noise_check: %d failure(s)\n", g_failures);
+        return 1;
+    }
+    printf("noise_check: OK\n");
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * plugin_api.h - Move plugin API definitions for the host-native tools
+ *
+ * The host and plugin structs of the v2 plugin API, as the tools that load
+ * a natively built dsp.so (chiptune_bench, golden_render, midi_check,
+ * state_check) see them. They must match src/dsp/chiptune_plugin.cpp.
+ *
+ * With PLUGIN_API_VIRTUAL_CLOCK defined before including it, it also
+ * replaces clock_gettime(CLOCK_MONOTONIC) with a virtual clock that reads
+ * g_clock_ns, so MIDI sent at a set time lands on an exact sample offset.
+ * The tool must be linked with -rdynamic so the plugin binds to it.
+ */
+
+#ifndef TOOLS_PLUGIN_API_H
+#define TOOLS_PLUGIN_API_H
+
+#include <stdint.h>
+
+extern "C" {
+
+typedef struct host_api_v1 {
+    uint32_t api_version;
+    int sample_rate;
+    int frames_per_block;
+    uint8_t *mapped_memory;
+    int audio_out_offset;
+    int audio_in_offset;
+    void (*log)(const char *msg);
+    int (*midi_send_internal)(const uint8_t *msg, int len);
+    int (*midi_send_external)(const uint8_t *msg, int len);
+} host_api_v1_t;
+
+typedef struct plugin_api_v2 {
+    uint32_t api_version;
+    void* (*create_instance)(const char *module_dir, const char *json_defaults);
+    void (*destroy_instance)(void *instance);
+    void (*on_midi)(void *instance, const uint8_t *msg, int len, int source);
+    void (*set_param)(void *instance, const char *key, const char *val);
+    int (*get_param)(void *instance, const char *key, char *buf, int buf_len);
+    int (*get_error)(void *instance, char *buf, int buf_len);
+    void (*render_block)(void *instance, int16_t *out_interleaved_lr, int frames);
+} plugin_api_v2_t;
+
+typedef plugin_api_v2_t* (*move_plugin_init_v2_fn)(const host_api_v1_t *host);
+
+} /* extern "C" */
+
+#ifdef PLUGIN_API_VIRTUAL_CLOCK
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+static int64_t g_clock_ns = 1000000000LL;
+
+extern "C" int clock_gettime(clockid_t id, struct timespec *ts) {
+    if (id != CLOCK_MONOTONIC) return (int)syscall(SYS_clock_gettime, id, ts);
+    ts->tv_sec = (time_t)(g_clock_ns / 1000000000LL);
+    ts->tv_nsec = (long)(g_clock_ns % 1000000000LL);
+    return 0;
+}
+
+#endif /* PLUGIN_API_VIRTUAL_CLOCK */
+
+#endif /* TOOLS_PLUGIN_API_H */
@@ -0,0 +1,212 @@
+/*
+ * GB readout check (host-native)
+ *
+ * Drives two Game Boy APUs with the same random register writes and checks
+ * that the fused gain readout (gb_apu_wrapper_read_samples_gain) matches
+ * read_samples followed by the plugin's old per-sample gain loop exactly,
+ * in both the mono and the stereo mix, with and without clipping, and for
+ * readout lengths that leave a partial vector block. The APU can't drive
+ * the mix itself past 16 bits, so a second test does that with square
+ * waves written straight into a Stereo_Buffer, in both directions.
+ *
+ * check.sh builds this once as is and once against tools/neon_emul, so the
+ * NEON path is checked on hosts without NEON.
+ *
+ * Build and run with ./scripts/check.sh
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "gb_apu_wrapper.h"
+#include "Multi_Buffer.h"
+
+#define SAMPLE_RATE 44100
+#define MAX_FRAMES  256
+#define ROUNDS      20000
+
+static uint32_t g_rand = 0x12345678u;
+
+static uint32_t next_rand(void) {
+    g_rand = g_rand * 1664525u + 1013904223u;
+    return g_rand >> 8;
+}
+
+static void write_both(gb_apu_wrapper_t *a, gb_apu_wrapper_t *b, unsigned addr, int data, long time) {
+    gb_apu_wrapper_write(a, addr, data, time);
+    gb_apu_wrapper_write(b, addr, data, time);
+}
+
+/* The readout the plugin used before the fused path */
+static int reference_read(gb_apu_wrapper_t *w, int16_t *out, int shorts, int gain, int *peak) {
+    static int16_t raw[MAX_FRAMES * 2];
+    int n = gb_apu_wrapper_read_samples(w, raw, shorts);
+    for (int s = 0; s < n; s++) {
+        int v = raw[s];
+        if (v > *peak) *peak = v;
+        if (-v > *peak) *peak = -v;
+        int32_t scaled = (int32_t)v * gain;
+        if (scaled > 32767) scaled = 32767;
+        if (scaled < -32768) scaled = -32768;
+        out[s] = (int16_t)scaled;
+    }
+    return n;
+}
+
+/*
+ * Square waves louder than full scale in the center (mono) or the center
+ * plus left (stereo), so the mix itself overflows, compared through both
+ * readouts. Returns mismatching reads; counts clipped samples by sign.
+ */
+static int check_mix_overflow(bool stereo, int gain, long *compared, long *clip_lo, long *clip_hi) {
+    static Stereo_Buffer a, b;
+    Stereo_Buffer *bufs[2] = {&a, &b};
+    static Blip_Synth<blip_good_quality, 1> synth;
+    synth.volume(stereo ? 0.8 : 1.3);
+
+    for (int i = 0; i < 2; i++) {
+        bufs[i]->clock_rate(4194304);
+        if (bufs[i]->set_sample_rate(SAMPLE_RATE, 50)) return 1;
+        bufs[i]->clear();
+    }
+
+    int failures = 0;
+    int level = 0;
+    for (int round = 0; round < 200; round++) {
+        int frames = 1 + (int)(next_rand() % MAX_FRAMES);
+        long cycles = a.center()->count_clocks(frames);
+        for (long t = 0; t < cycles; t += 4000 + (long)(next_rand() % 2000)) {
+            /* +-1: full scale times the synth volume */
+            int delta = level ? -2 * level : 1;
+            level += delta;
+            for (int i = 0; i < 2; i++) {
+                synth.offset(t, delta, bufs[i]->center());
+                if (stereo) synth.offset(t, delta, bufs[i]->left());
+            }
+        }
+        a.end_frame(cycles, stereo);
+        b.end_frame(cycles, stereo);
+
+        static blip_sample_t raw[MAX_FRAMES * 2];
+        int16_t want[MAX_FRAMES * 2], got[MAX_FRAMES * 2];
+        int want_peak = 0, got_peak = 0;
+        long n = a.read_samples(raw, frames * 2);
+        for (long s = 0; s < n; s++) {
+            int v = raw[s];
+            if (v > want_peak) want_peak = v;
+            if (-v > want_peak) want_peak = -v;
+            int32_t scaled = (int32_t)v * gain;
+            if (scaled > 32767) scaled = 32767;
+            if (scaled < -32768) scaled = -32768;
+            want[s] = (int16_t)scaled;
+            if (v == -32768) (*clip_lo)++;
+            if (v == 32767) (*clip_hi)++;
+        }
+        long m = b.read_samples(got, frames * 2, gain, &got_peak);
+        if (n != m || memcmp(want, got, (size_t)n * sizeof(int16_t)) != 0 || want_peak != got_peak) {
+            if (failures < 10) {
+                long s = 0;
+                while (s < n && s < m && want[s] == got[s]) s++;
+                printf("FAIL: %s mix overflow, gain %d round %d: read %ld/%ld, first difference at %ld "
+                       "(%d/%d), peak %d/%d\n", stereo ? "stereo" : "mono", gain, round, n, m, s,
+                       s < n ? want[s] : 0, s < m ? got[s] : 0, want_peak, got_peak);
+            }
+            failures++;
+        }
+        *compared += n;
+    }
+    return failures;
+}
+
+int main(void) {
+    static const int gains[] = { 1, 6, 40 };
+    int failures = 0;
+    long compared = 0, clipped = 0, stereo_rounds = 0;
+
+    for (unsigned g = 0; g < sizeof(gains) / sizeof(gains[0]); g++) {
+        int gain = gains[g];
+        gb_apu_wrapper_t *a = gb_apu_wrapper_create(SAMPLE_RATE, 50);
+        gb_apu_wrapper_t *b = gb_apu_wrapper_create(SAMPLE_RATE, 50);
+        if (!a || !b) {
+            fprintf(stderr, "gb_apu_wrapper_create failed\n");
+            return 1;
+        }
+
+        int panning = 0xFF;
+        for (int round = 0; round < ROUNDS; round++) {
+            int frames = 1 + (int)(next_rand() % MAX_FRAMES);
+            long cycles = gb_apu_wrapper_count_clocks(a, frames);
+
+            /* Mostly centred, sometimes panned so the stereo mix is used */
+            if (next_rand() % 64 == 0) {
+                panning = (next_rand() % 4 == 0) ? 0xFF : (int)(next_rand() & 0xFF);
+                write_both(a, b, 0xFF25, panning, 0);
+            }
+            if (next_rand() % 16 == 0) {
+                write_both(a, b, 0xFF30 + next_rand() % 16, (int)(next_rand() & 0xFF), 0);
+            }
+
+            /* Writes must come in time order */
+            int writes = (int)(next_rand() % 6);
+            long time = 0;
+            for (int i = 0; i < writes; i++) {
+                time += (long)(next_rand() % (unsigned)(cycles / 6 + 1));
+                unsigned addr = 0xFF10 + next_rand() % 0x17;
+                if (addr == 0xFF25 || addr == 0xFF26) continue;
+                int data = (int)(next_rand() & 0xFF);
+                /* Loud envelopes and retriggers, so the output clips */
+                if (addr == 0xFF12 || addr == 0xFF17 || addr == 0xFF21) data |= 0xF0;
+                if (addr == 0xFF14 || addr == 0xFF19 || addr == 0xFF1E || addr == 0xFF23) data |= 0x80;
+                write_both(a, b, addr, data, time);
+            }
+            if (panning != 0xFF) stereo_rounds++;
+
+            gb_apu_wrapper_end_frame(a, cycles);
+            gb_apu_wrapper_end_frame(b, cycles);
+
+            int16_t want[MAX_FRAMES * 2], got[MAX_FRAMES * 2];
+            int want_peak = 0, got_peak = 0;
+            int n = reference_read(a, want, frames * 2, gain, &want_peak);
+            int m = gb_apu_wrapper_read_samples_gain(b, got, frames * 2, gain, &got_peak);
+
+            if (n != m || memcmp(want, got, (size_t)n * sizeof(int16_t)) != 0 || want_peak != got_peak) {
+                if (failures < 10) {
+                    int s = 0;
+                    while (s < n && s < m && want[s] == got[s]) s++;
+                    printf("FAIL: gain %d round %d: read %d/%d, first difference at %d, peak %d/%d\n",
+                           gain, round, n, m, s, want_peak, got_peak);
+                }
+                failures++;
+            }
+            for (int s = 0; s < n; s++) {
+                if (want[s] == 32767 || want[s] == -32768) clipped++;
+            }
+            compared += n;
+        }
+
+        gb_apu_wrapper_destroy(a);
+        gb_apu_wrapper_destroy(b);
+    }
+
+    printf("%ld samples compared (%ld clipped, %ld stereo rounds)\n", compared, clipped, stereo_rounds);
+
+    long mix_compared = 0, clip_lo = 0, clip_hi = 0;
+    for (int stereo = 0; stereo < 2; stereo++) {
+        failures += check_mix_overflow(stereo != 0, 1, &mix_compared, &clip_lo, &clip_hi);
+        failures += check_mix_overflow(stereo != 0, 3, &mix_compared, &clip_lo, &clip_hi);
+    }
+    printf("%ld samples with the mix overflowing (%ld clipped low, %ld high)\n",
+           mix_compared, clip_lo, clip_hi);
+    if (!clip_lo || !clip_hi) {
+        printf("FAIL: the mix didn't overflow in both directions\n");
+        failures++;
+    }
+    if (failures) {
+        printf("%d mismatching reads\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,329 @@
+/*
+ * Saved state check (host-native)
+ *
+ * Checks the JSON scanner and base64 codec used for state restore on
+ * well-formed and malformed input, then loads a natively built dsp.so and
+ * checks that "state" and "state_bin" saved from one instance restore
+ * exactly into another for every preset with randomised params, that keys
+ * are only matched as member names, and that bad input is ignored.
+ *
+ * Build and run with ./scripts/check.sh
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <dlfcn.h>
+
+#include "json_scan.h"
+#include "base64.h"
+
+#include "plugin_api.h"
+
+#define STATE_MAX 2048
+
+static int g_failures = 0;
+
+static void fail(const char *what, const char *detail) {
+    if (g_failures < 20) printf("FAIL: %s: %s\n", what, detail);
+    g_failures++;
+}
+
+static uint32_t g_rng = 0x2545F491u;
+
+static uint32_t rng_next(void) {
+    g_rng = g_rng * 1664525u + 1013904223u;
+    return g_rng >> 8;
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* =====================================================================
+ * Scanner
+ * ===================================================================== */
+
+static void check_scan(const char *json, int expect_count) {
+    json_member_t m[8];
+    int n = json_scan_object(json, m, 8);
+    if (n != expect_count) {
+        char detail[256];
+        snprintf(detail, sizeof(detail), "%s -> %d members, expected %d", json, n, expect_count);
+        fail("scan", detail);
+    }
+}
+
+static void check_scanner(void) {
+    /* Well-formed */
+    check_scan("{}", 0);
+    check_scan("  { }  ", 0);
+    check_scan("{\"a\":1}", 1);
+    check_scan("{ \"a\" : -1.5e3 ,\n\t\"b\":\"x\\\"y\" }", 2);
+    check_scan("{\"a\":{\"b\":[1,{\"c\":\"]}\"}]},\"d\":null,\"e\":true,\"f\":false}", 4);
+    check_scan("{\"a\":0,\"a\":1}", 2);
+
+    /* Malformed or not an object */
+    check_scan("", -1);
+    check_scan("[1]", -1);
+    check_scan("{", -1);
+    check_scan("{\"a\":1", -1);
+    check_scan("{\"a\":1,}", -1);
+    check_scan("{\"a\" 1}", -1);
+    check_scan("{a:1}", -1);
+    check_scan("{\"a\":01}", -1);
+    check_scan("{\"a\":1.}", -1);
+    check_scan("{\"a\":-}", -1);
+    check_scan("{\"a\":nul}", -1);
+    check_scan("{\"a\":\"x}", -1);
+    check_scan("{\"a\":[1,2}", -1);
+    check_scan("{\"a\":1} x", -1);
+    check_scan("{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,\"g\":7,\"h\":8,\"i\":9}", -1);
+
+    /* Keys and values */
+    json_member_t m[4];
+    float v = 0;
+    int n = json_scan_object("{\"duty\":\"\\\"duty\\\":3\",\"duty_x\":2,\"duty\":1.25}", m, 4);
+    if (n != 3 || !json_member_is(&m[0], "duty") || m[0].type != JSON_STRING ||
+        json_member_number(&m[0], &v) == 0 || json_member_is(&m[1], "duty") ||
+        !json_member_is(&m[2], "duty") || json_member_number(&m[2], &v) != 0 || v != 1.25f) {
+        fail("scan", "member keys/values");
+    }
+}
+
+/* =====================================================================
+ * Base64
+ * ===================================================================== */
+
+static void check_base64(void) {
+    /* RFC 4648 test vectors */
+    static const char *const plain[] = {"", "f", "fo", "foo", "foob", "fooba", "foobar"};
+    static const char *const coded[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy"};
+    char text[16];
+    uint8_t data[16];
+    for (int i = 0; i < 7; i++) {
+        int len = (int)strlen(plain[i]);
+        if (base64_encode((const uint8_t *)plain[i], len, text, sizeof(text)) != (int)strlen(coded[i]) ||
+            strcmp(text, coded[i]) != 0) {
+            fail("base64 encode", plain[i]);
+        }
+        if (base64_decode(coded[i], data, sizeof(data)) != len || memcmp(data, plain[i], len) != 0) {
+            fail("base64 decode", coded[i]);
+        }
+    }
+
+    static const char *const bad[] = {"Zg", "Zg=", "Z===", "Zg==Zg==", "Zm9v!A==", "Zg=a", "Zm 9v"};
+    for (int i = 0; i < 7; i++) {
+        if (base64_decode(bad[i], data, sizeof(data)) >= 0) fail("base64 invalid", bad[i]);
+    }
+    if (base64_decode("Zm9vYmFy", data, 5) >= 0) fail("base64 overflow", "Zm9vYmFy");
+    if (base64_encode((const uint8_t *)"foo", 3, text, 4) >= 0) fail("base64 overflow", "foo");
+}
+
+/* =====================================================================
+ * Round trip through the plugin
+ * ===================================================================== */
+
+/* Params set at random before saving; chip and enums by number */
+static const struct {
+    const char *key;
+    int min, max;
+} g_random_params[] = {
+    {"chip", 0, 1}, {"duty", 0, 3}, {"env_attack", 0, 15}, {"env_decay", 0, 15},
+    {"env_sustain", 0, 15}, {"env_release", 0, 15}, {"sweep", 0, 7},
+    {"vibrato_depth", 0, 12}, {"vibrato_rate", 0, 10}, {"noise_mode", 0, 1},
+    {"wavetable", 0, 7}, {"channel_mask", 0, 31}, {"detune", 0, 50},
+    {"volume", 0, 15}, {"octave_transpose", -3, 3}, {"alloc_mode", 0, 2},
+    {"pitch_env_depth", 0, 24}, {"pitch_env_speed", 0, 15},
+    {"vibrato_shape", 0, 3}, {"control_rate", 0, 5},
+};
+#define NUM_RANDOM_PARAMS (int)(sizeof(g_random_params) / sizeof(g_random_params[0]))
+
+static void get_state(const plugin_api_v2_t *api, void *inst, char *buf) {
+    if (api->get_param(inst, "state", buf, STATE_MAX) <= 0) {
+        fail("get_param(state)", "no state");
+        buf[0] = '\0';
+    }
+}
+
+/* Randomise some params of inst, optionally with fractional values (never
+ * for chip, which only takes NES or GB) */
+static void randomise(const plugin_api_v2_t *api, void *inst, int fractional) {
+    char buf[16];
+    for (int i = 0; i < NUM_RANDOM_PARAMS; i++) {
+        if (rng_next() % 3) continue;
+        int range = g_random_params[i].max - g_random_params[i].min + 1;
+        int v = g_random_params[i].min + (int)(rng_next() % range);
+        if (fractional && i > 0 && v < g_random_params[i].max && (rng_next() & 1)) {
+            snprintf(buf, sizeof(buf), "%d.%d", v, 1 + (int)(rng_next() % 9));
+        } else {
+            snprintf(buf, sizeof(buf), "%d", v);
+        }
+        api->set_param(inst, g_random_params[i].key, buf);
+    }
+}
+
+static void check_round_trip(const plugin_api_v2_t *api, const char *module_dir, int preset_count) {
+    char saved[STATE_MAX], restored[STATE_MAX], buf[16];
+    void *src = api->create_instance(module_dir, NULL);
+    void *dst = api->create_instance(module_dir, NULL);
+    int trips = 0;
+
+    for (int round = 0; round < 8; round++) {
+        for (int p = 0; p < preset_count; p++) {
+            snprintf(buf, sizeof(buf), "%d", p);
+            api->set_param(src, "preset", buf);
+            /* Round 0 saves the presets as they are */
+            if (round > 0) randomise(api, src, 0);
+            get_state(api, src, saved);
+
+            /* Start the restoring instance from a different preset */
+            snprintf(buf, sizeof(buf), "%d", (p + 1 + round) % preset_count);
+            api->set_param(dst, "preset", buf);
+            api->set_param(dst, "state", saved);
+            get_state(api, dst, restored);
+            if (strcmp(saved, restored) != 0) fail("round trip", saved);
+            trips++;
+        }
+    }
+
+    /* Keys inside string values, unknown members and nesting are ignored */
+    char expect[STATE_MAX];
+    api->set_param(src, "preset", "2");
+    get_state(api, src, expect);
+    api->set_param(dst, "preset", "5");
+    api->set_param(dst, "state",
+        " {\"label\":\"\\\"duty\\\":3,\\\"volume\\\":0\",\"extra\":{\"volume\":1,\"list\":[\"duty\"]},"
+        "\"preset\":2, \"unknown\":7, \"volume\":\"0\"} ");
+    get_state(api, dst, restored);
+    if (strcmp(expect, restored) != 0) fail("keys in values", restored);
+
+    /* Malformed state is ignored as a whole */
+    api->set_param(dst, "preset", "3");
+    get_state(api, dst, expect);
+    api->set_param(dst, "state", "{\"preset\":2,\"volume\":1");
+    get_state(api, dst, restored);
+    if (strcmp(expect, restored) != 0) fail("malformed state", restored);
+
+    /* Restore cost, for loading sets with many instances */
+    get_state(api, src, saved);
+    const int restores = 2000;
+    int64_t t0 = now_ns();
+    for (int i = 0; i < restores; i++) api->set_param(dst, "state", saved);
+    int64_t dt = now_ns() - t0;
+
+    api->destroy_instance(src);
+    api->destroy_instance(dst);
+    printf("%d state round trips; restore mean %.0f ns\n", trips, (double)dt / restores);
+}
+
+/* state_bin keeps fractional values, so both its own string and the JSON
+ * state must match after a restore */
+static void check_bin_round_trip(const plugin_api_v2_t *api, const char *module_dir, int preset_count) {
+    char saved[STATE_MAX], restored[STATE_MAX], json[STATE_MAX], buf[16];
+    void *src = api->create_instance(module_dir, NULL);
+    void *dst = api->create_instance(module_dir, NULL);
+    int trips = 0;
+
+    for (int round = 0; round < 8; round++) {
+        for (int p = 0; p < preset_count; p++) {
+            snprintf(buf, sizeof(buf), "%d", p);
+            api->set_param(src, "preset", buf);
+            if (round > 0) randomise(api, src, 1);
+            if (api->get_param(src, "state_bin", saved, STATE_MAX) <= 0) fail("get_param(state_bin)", "no state");
+            get_state(api, src, json);
+
+            snprintf(buf, sizeof(buf), "%d", (p + 1 + round) % preset_count);
+            api->set_param(dst, "preset", buf);
+            randomise(api, dst, 1);
+            api->set_param(dst, "state_bin", saved);
+            api->get_param(dst, "state_bin", restored, STATE_MAX);
+            if (strcmp(saved, restored) != 0) fail("state_bin round trip", saved);
+            get_state(api, dst, restored);
+            if (strcmp(json, restored) != 0) fail("state_bin vs state", restored);
+            trips++;
+        }
+    }
+
+    /* A blob from a version with fewer params restores the ones it has */
+    uint8_t data[1100];
+    int len = base64_decode(saved, data, sizeof(data));
+    if (len < 12 || data[7] * 4 + 8 != len) {
+        fail("state_bin layout", saved);
+    } else {
+        data[7]--;
+        char older[STATE_MAX];
+        base64_encode(data, len - 4, older, STATE_MAX);
+        api->set_param(dst, "preset", "0");
+        api->set_param(dst, "state_bin", older);
+        api->get_param(dst, "state_bin", restored, STATE_MAX);
+        uint8_t back[1100];
+        if (base64_decode(restored, back, sizeof(back)) != len ||
+            memcmp(back + 8, data + 8, len - 12) != 0) {
+            fail("older state_bin", older);
+        }
+    }
+
+    /* Invalid blobs are ignored */
+    static const char *const bad[] = {"", "!!!!", "Q0hQVA==", "AAAAAAAAAAA="};
+    api->get_param(dst, "state_bin", saved, STATE_MAX);
+    for (int i = 0; i < 4; i++) {
+        api->set_param(dst, "state_bin", bad[i]);
+        api->get_param(dst, "state_bin", restored, STATE_MAX);
+        if (strcmp(saved, restored) != 0) fail("invalid state_bin", bad[i]);
+    }
+
+    const int restores = 2000;
+    int64_t t0 = now_ns();
+    for (int i = 0; i < restores; i++) api->set_param(dst, "state_bin", saved);
+    int64_t dt = now_ns() - t0;
+
+    api->destroy_instance(src);
+    api->destroy_instance(dst);
+    printf("%d state_bin round trips; restore mean %.0f ns\n", trips, (double)dt / restores);
+}
+
+int main(int argc, char **argv) {
+    const char *so_path = argc > 1 ? argv[1] : "build/host/dsp.so";
+    const char *module_dir = "src";
+
+    check_scanner();
+    check_base64();
+
+    void *handle = dlopen(so_path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        fprintf(stderr, "dlopen failed: %s\n", dlerror());
+        return 1;
+    }
+    move_plugin_init_v2_fn init = (move_plugin_init_v2_fn)dlsym(handle, "move_plugin_init_v2");
+    if (!init) {
+        fprintf(stderr, "move_plugin_init_v2 not found\n");
+        return 1;
+    }
+    static host_api_v1_t host;
+    host.api_version = 1;
+    host.sample_rate = 44100;
+    host.frames_per_block = 128;
+    const plugin_api_v2_t *api = init(&host);
+
+    void *inst = api->create_instance(module_dir, NULL);
+    char buf[16];
+    int preset_count = 0;
+    if (api->get_param(inst, "preset_count", buf, sizeof(buf)) > 0) preset_count = atoi(buf);
+    api->destroy_instance(inst);
+
+    check_round_trip(api, module_dir, preset_count);
+    check_bin_round_trip(api, module_dir, preset_count);
+
+    dlclose(handle);
+    if (g_failures) {
+        printf("%d failures\n", g_failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}